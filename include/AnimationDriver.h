@@ -1,5 +1,16 @@
 #include <stdint.h>
 #define ANIMATION // Used to stop duplicate imports
+#define MAX_FRAMES 20 // Frame capacity of a single animation
+
+// Optional pre-rendered cycle, enable with -D RENDER_CACHE in build_flags
+#ifdef RENDER_CACHE
+#ifndef RENDER_CACHE_BYTES
+#define RENDER_CACHE_BYTES 4096 // RAM for cached colors, 3 bytes per sample
+#endif
+#ifndef RENDER_CACHE_STEP
+#define RENDER_CACHE_STEP 4 // ms between cached samples, keep it a power of 2
+#endif
+#endif
 
 namespace AnimationDriver
 {
@@ -14,11 +25,26 @@ namespace AnimationDriver
     // Structure that holds an entire animation
     struct animation
     {
-        animFrame frames[20]; // List of frames (fixed size array)
+        animFrame frames[MAX_FRAMES]; // List of frames (fixed size array)
         uint8_t frameCount;   // Number of entries with useful data in the frames buffer
         uint32_t time;        // Total runtime of this animation (redundant with "time" member of last relevant item in frames array)
     };
 
+    /**
+     * Linearly interpolates the color between two frames, this is the exact math used during playback
+     * @param time time within the animation, expected between last.time and next.time
+     */
+    void interpolate(const animFrame &last, const animFrame &next, unsigned long time, uint8_t color[3]);
+
+    /**
+     * Color of an animation at any time since its start, looping every anim.time ms. Pure and reentrant,
+     * the driver plays animations through it and host tools can sample any t on any thread
+     * @param t time since the animation started (ms)
+     * @param hint optional segment to start searching from, updated to the segment used. Sampling with
+     *             increasing t and the same hint walks the frames once per period instead of once per call
+     */
+    void evaluate(const animation &anim, uint32_t t, uint8_t color[3], uint8_t *hint = nullptr);
+
     // Typedef for parent function that will call actually drive the LEDs
     typedef void (*drivingFunc)(uint8_t, uint8_t, uint8_t);
     // Typedef for system time function
@@ -36,13 +62,24 @@ namespace AnimationDriver
         sysTimeFunc _getSysTime;
         void updateTime();       // Update current time within animation
         void interpolateColor(); // Calculates current color
+#ifdef RENDER_CACHE
+        // One period sampled every RENDER_CACHE_STEP ms, played back by lookup instead of interpolating each tick
+        uint8_t cache[RENDER_CACHE_BYTES];
+        uint16_t cacheLength; // Samples in the cache, 0 when the animation doesn't fit
+        void buildCache();
+#endif
 
     public:
         AnimationDriver(animation, sysTimeFunc);
         AnimationDriver(sysTimeFunc);
-        void updateAnimation(animation);
+        void updateAnimation(const animation &);
         void run(drivingFunc); // Takes a pointer to the parent function that runs hardware
         void restart();        // Used to reset all time-dependant logic
+        unsigned long phase() const { return currentTime; } // ms into the animation as of the last run()
+        void seek(unsigned long t);                         // Continue playback from t ms into the animation
+#ifdef RENDER_CACHE
+        bool cached() const { return cacheLength != 0; }
+#endif
     };
 
 } // Namespace AnimationDriver
\ No newline at end of file
@@ -0,0 +1,13 @@
+#include <stddef.h>
+#include <stdint.h>
+#define CHECKSUM // Used to stop duplicate imports
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), shared by the lamp and the host tools
+#define CRC16_INIT 0xFFFF
+
+namespace Checksum
+{
+    uint16_t crc16(uint16_t crc, uint8_t data);
+    uint16_t crc16(uint16_t crc, const uint8_t *data, size_t len);
+
+} // namespace Checksum
@@ -0,0 +1,63 @@
+#include <stdint.h>
+#define COLOR_MATH // Used to stop duplicate imports
+
+/**
+ * Color arithmetic on packed 0x00RRGGBB words, all three channels at once (SIMD within a register).
+ * R and B sit in the 0x00FF00FF lanes with 8 guard bits above each, so one multiply covers both and
+ * G takes a second one. Weights run 0..256, where 256 means all of the second color.
+ */
+#define COLOR_RB 0x00FF00FFUL
+#define COLOR_G 0x0000FF00UL
+
+namespace ColorMath
+{
+    typedef uint32_t packed;
+
+    inline packed pack(uint8_t r, uint8_t g, uint8_t b)
+    {
+        return (packed)r << 16 | (packed)g << 8 | b;
+    }
+
+    inline void unpack(packed c, uint8_t out[3])
+    {
+        out[0] = c >> 16;
+        out[1] = c >> 8;
+        out[2] = c;
+    }
+
+    // a * (256 - w) + b * w per channel, each lane peaks at 255 * 256 so nothing carries into the next
+    inline packed lerp(packed a, packed b, uint16_t w)
+    {
+        uint16_t v = 256 - w;
+        packed rb = ((a & COLOR_RB) * v + (b & COLOR_RB) * w) >> 8;
+        packed g = ((a & COLOR_G) * v + (b & COLOR_G) * w) >> 8;
+        return (rb & COLOR_RB) | (g & COLOR_G);
+    }
+
+    // Brightness, level 0..256
+    inline packed scale(packed c, uint16_t level)
+    {
+        return ((c & COLOR_RB) * level >> 8 & COLOR_RB) | ((c & COLOR_G) * level >> 8 & COLOR_G);
+    }
+
+    // Draw over on top of under with alpha 0..256
+    inline packed blend(packed under, packed over, uint16_t alpha)
+    {
+        return lerp(under, over, alpha);
+    }
+
+    // How far pos is into span as a 0..256 weight, past the end (or an empty span) counts as the end
+    inline uint16_t weight(uint32_t pos, uint32_t span)
+    {
+        if (pos >= span)
+            return 256;
+        // Keep pos << 8 inside 32 bits
+        while (span > 0xFFFFFFUL)
+        {
+            span >>= 1;
+            pos >>= 1;
+        }
+        return (uint16_t)((pos << 8) / span);
+    }
+
+} // namespace ColorMath
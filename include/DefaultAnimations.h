@@ -38,3 +38,25 @@
                                                            },                                   \
                                                            13,                                  \
                                                            time})
+
+
+#ifndef PROGMEM
+#define PROGMEM // Host builds have no separate program memory
+#endif
+
+// Default animations
+// Note animation size is 168 bytes & eeprom is 1kB
+const AnimationDriver::animation Solid_White PROGMEM = SOLID_COLOR(255, 255, 255);
+const AnimationDriver::animation Solid_Red PROGMEM = SOLID_COLOR(255, 0, 0);
+const AnimationDriver::animation Breathe_White PROGMEM = BREATHE_COLOR(255, 255, 255, 3000UL);
+const AnimationDriver::animation Solid_Green PROGMEM = SOLID_COLOR(0, 255, 0);
+const AnimationDriver::animation Rainbow PROGMEM = RAINBOW(4000UL);
+const AnimationDriver::animation Solid_Blue PROGMEM = SOLID_COLOR(0, 0, 255);
+
+const AnimationDriver::animation defaults[] PROGMEM = {
+    Solid_White,
+    Solid_Red,
+    Breathe_White,
+    Solid_Green,
+    Rainbow,
+    Solid_Blue};
@@ -0,0 +1,70 @@
+#include <stdint.h>
+#define EVENT_QUEUE // Used to stop duplicate imports
+
+// Keeps the compiler from moving item accesses past the index that publishes them
+#define QUEUE_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+namespace Events
+{
+    // Event types, meaning of the value byte is listed per type
+    enum eventType : uint8_t
+    {
+        MODE_NEXT,    // -
+        MODE_PREV,    // -
+        BRIGHTNESS,   // new strip brightness
+        SLOT_UPDATED, // slot whose stored animation changed, ALL_SLOTS for the whole image
+        PREVIEW       // slot currentAnim was previewed for, PREVIEW_END once currentAnim no longer holds it
+    };
+
+    struct event
+    {
+        eventType type;
+        uint8_t value;
+    };
+
+} // namespace Events
+
+#define ALL_SLOTS 0xFF
+#define PREVIEW_END 0xFF
+#define EVENT_QUEUE_SIZE 8 // Events the lamp queues between frames, plus one
+
+/**
+ * Fixed capacity single producer, single consumer ring, holds SIZE - 1 items.
+ * Lock free: only the producer writes head and only the consumer writes tail, both single bytes so every
+ * target reads and writes them atomically. Either side may run in an interrupt, as long as there is one of each.
+ * push() fails rather than overwrite, so a producer that gets false keeps its item and tries again later.
+ */
+template <typename T, uint8_t SIZE>
+class EventQueue
+{
+public:
+    bool push(const T &item)
+    {
+        uint8_t next = (head + 1) % SIZE;
+        if (next == tail)
+            return false;
+        items[head] = item;
+        QUEUE_BARRIER();
+        head = next;
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        if (tail == head)
+            return false;
+        QUEUE_BARRIER();
+        item = items[tail];
+        QUEUE_BARRIER();
+        tail = (tail + 1) % SIZE;
+        return true;
+    }
+
+    bool empty() const { return head == tail; }
+    uint8_t space() const { return (tail + SIZE - 1 - head) % SIZE; }
+
+private:
+    T items[SIZE];
+    volatile uint8_t head = 0; // Next slot to write
+    volatile uint8_t tail = 0; // Next slot to read
+};
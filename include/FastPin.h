@@ -0,0 +1,37 @@
+#include <Arduino.h>
+#define FAST_PIN // Used to stop duplicate imports
+
+/**
+ * Compile time pin traits: FastPin<PIN>::read() becomes a single register read for the button pins of
+ * each board, anything without a trait falls back to digitalRead(). Under SIM every pin uses the
+ * simulator's digitalRead(), which is the host mock for button input.
+ * Pins still have to be set up with pinMode() first (on the SAMD that also enables the input buffer).
+ */
+template <uint8_t PIN>
+struct FastPin
+{
+    static inline bool read() { return digitalRead(PIN); }
+};
+
+#define FAST_PIN_TRAIT(pin, reg, bit)                                \
+    template <>                                                      \
+    struct FastPin<pin>                                              \
+    {                                                                \
+        static inline bool read() { return (reg) & (1UL << (bit)); } \
+    };
+
+#if defined(SIM)
+// Host mock, see above
+#elif defined(MICRO)
+// ATmega32u4, Leonardo numbering
+FAST_PIN_TRAIT(5, PINC, 6)
+FAST_PIN_TRAIT(7, PINE, 6)
+#elif defined(NANO)
+// ATmega328P
+FAST_PIN_TRAIT(3, PIND, 3)
+FAST_PIN_TRAIT(4, PIND, 4)
+#elif defined(XIAO)
+// SAMD21, read through the single cycle IOBUS port
+FAST_PIN_TRAIT(9, PORT_IOBUS->Group[0].IN.reg, 5)
+FAST_PIN_TRAIT(8, PORT_IOBUS->Group[0].IN.reg, 7)
+#endif
@@ -0,0 +1,29 @@
+#include <Adafruit_NeoPixel.h>
+#define PIXEL_OUTPUT // Used to stop duplicate imports
+
+/**
+ * NeoPixel strip that tracks the last pixel changed since the last refresh.
+ * update() skips the transmission entirely when nothing changed, and otherwise only clocks out pixels up to
+ * the last changed one (pixels further down the chain keep their latched color). The chain shifts data in from
+ * the first pixel, so leading pixels are always resent. An optional rate cap holds changes back between refreshes.
+ */
+class PixelOutput : public Adafruit_NeoPixel
+{
+public:
+    PixelOutput(uint16_t n, int16_t pin, neoPixelType type);
+
+    // Same as the base versions but mark what actually changed
+    void setPixelColor(uint16_t n, uint32_t c);
+    void fill(uint32_t c = 0, uint16_t first = 0, uint16_t count = 0);
+    void setBrightness(uint8_t);
+
+    bool update();                 // Refresh up to the last changed pixel if allowed by the rate cap, true if anything was sent
+    void setMaxRate(uint16_t hz);  // Cap refreshes per second, 0 for no cap
+    bool dirty() const { return dirtyCount != 0; }
+
+private:
+    uint16_t dirtyCount;  // Pixels to clock out on the next refresh, 0 when nothing changed
+    uint32_t minInterval; // us between refreshes
+    uint32_t lastShow;
+    void markDirty(uint16_t last);
+};
@@ -0,0 +1,71 @@
+#include <stdint.h>
+#define PROFILER // Used to stop duplicate imports
+
+// Enable with -D PROFILE in build_flags, compiles to nothing otherwise
+#ifdef PROFILE
+#include <Arduino.h> // micros(), AnimationDriver.cpp doesn't pull it in otherwise
+#define PROFILE_BEGIN(section) uint32_t _profStart_##section = micros()
+#define PROFILE_END(section) Profiler::record(Profiler::section, micros() - _profStart_##section)
+// Time since the previous pass through the same spot
+#define PROFILE_INTERVAL(section)                                                  \
+    do                                                                             \
+    {                                                                              \
+        static uint32_t _profLast = 0;                                             \
+        uint32_t _profNow = micros();                                              \
+        if (_profLast)                                                             \
+            Profiler::record(Profiler::section, _profNow - _profLast);             \
+        _profLast = _profNow;                                                      \
+    } while (0)
+#else
+#define PROFILE_BEGIN(section)
+#define PROFILE_END(section)
+#define PROFILE_INTERVAL(section)
+#endif
+
+// Number of log2 buckets in the loop time histogram (bucket n holds loops under 2^(n+1) us)
+#define PROFILE_HIST_BINS 16
+
+// Code sections that get timed as X(id, name), the names are what host tools print (tools/lampctl includes this too)
+//  CACHE_BUILD: render cache build on animation load (-D RENDER_CACHE)
+//  FRAME: interval between render steps, its spread is the frame jitter
+#define PROFILE_SECTIONS(X)           \
+    X(LOOP, "loop")                   \
+    X(RUN, "run")                     \
+    X(SHOW, "show")                   \
+    X(ANALOG, "analogRead")           \
+    X(EEPROM_LOAD, "EEPROM_Load")     \
+    X(CACHE_BUILD, "cache build")     \
+    X(FRAME, "frame")
+#define PROFILE_SECTION_ID(id, name) id,
+#define PROFILE_SECTION_NAME(id, name) name,
+
+namespace Profiler
+{
+    // Code sections that get timed, see PROFILE_SECTIONS
+    enum section : uint8_t
+    {
+        PROFILE_SECTIONS(PROFILE_SECTION_ID)
+        SECTION_COUNT
+    };
+
+    // Timing stats of a single section, all times in us (mean = total / count)
+    struct sectionStats
+    {
+        uint32_t min;
+        uint32_t max;
+        uint32_t total;
+        uint32_t count;
+    };
+
+    // Entire profiler state, kept in one fixed block of RAM
+    struct stats
+    {
+        sectionStats sections[SECTION_COUNT];
+        uint16_t loopHist[PROFILE_HIST_BINS]; // Loop time histogram
+    };
+
+    void record(section, uint32_t); // Add a measurement (us) to a section
+    void reset();                   // Clear all stats
+    void dump();                    // Write stats to serial in binary
+
+} // namespace Profiler
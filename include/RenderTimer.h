@@ -0,0 +1,29 @@
+#include <stdint.h>
+#define RENDER_TIMER_H // Used to stop duplicate imports
+
+// Enable with -D RENDER_TIMER in build_flags, the render step then runs from a hardware timer instead of loop()
+#ifdef RENDER_TIMER
+#ifndef RENDER_RATE
+#define RENDER_RATE 100 // Render ticks per second
+#endif
+#define RENDER_HOLD() RenderTimer::hold()
+#define RENDER_RELEASE() RenderTimer::release()
+#else
+#define RENDER_HOLD()
+#define RENDER_RELEASE()
+#endif
+
+/**
+ * Fixed rate tick for the render step: Timer1 compare match on the AVRs, TC3 on the SAMD21, a thread under SIM
+ * (provided by the host simulator). The tick runs in interrupt context, anything it shares with loop() has to be
+ * changed between hold() and release(), which only mask the tick and leave every other interrupt running.
+ */
+namespace RenderTimer
+{
+    typedef void (*tickFunc)();
+
+    void begin(uint16_t hz, tickFunc tick); // Start calling tick hz times per second
+    void hold();                            // Keep the tick from running, nests
+    void release();                         // Undo one hold(), a tick that came due meanwhile runs right away
+
+} // namespace RenderTimer
@@ -0,0 +1,39 @@
+#include <stdint.h>
+#define SCHEDULER // Used to stop duplicate imports
+
+#ifndef MAX_TASKS
+#define MAX_TASKS 6 // Task table capacity
+#endif
+
+/**
+ * Cooperative run to completion scheduler. Every run() call picks the highest priority task that is due, either
+ * because its period elapsed or because its ready check reports work, and runs it once. Tasks are plain functions
+ * that keep no stack between runs, so a task only holds up the others for as long as a single run takes.
+ * Run time is accounted per task so each task's share of the CPU can be read back over serial.
+ */
+namespace Scheduler
+{
+    typedef void (*taskFunc)();
+    typedef bool (*readyFunc)();
+
+    // Run time of a single task, all times in us (share = total / window)
+    struct taskStats
+    {
+        uint32_t runs;
+        uint32_t total;
+        uint32_t max;
+    };
+
+    /**
+     * Registers a task, tasks are reported in the order they are added
+     * @param periodMs ms between runs, 0 to only run when ready() says so
+     * @param priority higher runs first, ties go to the task added first
+     * @param ready optional check, the task is also due whenever it returns true
+     * @return false if the table is full (raise MAX_TASKS), the task would never run
+     */
+    bool add(taskFunc run, uint16_t periodMs, uint8_t priority, readyFunc ready = nullptr);
+    bool run();   // Run the most urgent due task, false if nothing was due
+    void reset(); // Clear the stats and start a new measurement window
+    void dump();  // Write stats to serial in binary
+
+} // namespace Scheduler
@@ -0,0 +1,77 @@
+#include <Arduino.h>
+#ifndef EVENT_QUEUE
+#include <EventQueue.h>
+#endif
+#define SERIAL_RX // Used to stop duplicate imports
+
+// Bytes the lamp can take in while loop() is busy, kept below 256 so the ring indices stay single bytes
+#ifndef RX_BUFFER
+#if defined(XIAO)
+#define RX_BUFFER 255
+#else
+#define RX_BUFFER 128
+#endif
+#endif
+
+#ifndef RX_TIMEOUT
+#define RX_TIMEOUT 1000 // ms readBytes()/readUntil() wait for the next byte, same as Stream's default
+#endif
+
+/**
+ * Where the ring is filled from. The NANO's UART core (HardwareSerial) keeps its receive buffer as a single
+ * producer/single consumer ring: its RX interrupt only moves head, read() only moves tail. With the pump as the one
+ * and only reader it may run in an interrupt, so it drains the core from Timer0 compare B while loop() is busy.
+ * The pump interrupt re-enables interrupts first, so the RX interrupt keeps taking bytes while it runs.
+ * The USB CDC cores (MICRO, XIAO) share endpoint state between their USB interrupt and whoever reads, so they are
+ * only read from loop() and the ring does not fill while loop() is busy. Limitation: during a long render or EEPROM
+ * write, bytes wait in the core's buffer. CDC flow control normally holds the host off, but a host that gives up on
+ * a stalled write, or a core that drops when its buffer is full, loses data there and overflows can't see it.
+ */
+#if defined(NANO) && !defined(SIM)
+#define RX_PUMP_ISR
+#endif
+
+// Bytes the UART core holds before it drops what arrives, one less than its buffer
+#if defined(NANO)
+#define RX_CORE_BUFFER (SERIAL_RX_BUFFER_SIZE - 1)
+#endif
+
+/**
+ * Input side of the serial protocol. Received bytes are moved from the core's small buffer into a ring of
+ * RX_BUFFER - 1 bytes, from an interrupt on the NANO and from poll() (also called by every read) elsewhere.
+ * Every read in the protocol goes through here instead of Serial, the pump is the only one reading Serial.
+ */
+class SerialRx
+{
+public:
+    // Receive stats, reset by every dump()
+    struct rxStats
+    {
+        uint16_t capacity;  // Bytes the ring holds
+        uint16_t highWater; // Most bytes held at once
+        uint32_t overflows; // Times the UART core's buffer was found full, bytes arriving then were dropped. Only measured on the NANO, always 0 on USB CDC
+        uint32_t stalls;    // Times the ring was full while the core still had bytes waiting, the lamp reads slower than the host sends
+        uint32_t received;  // Bytes moved into the ring
+    };
+
+    void begin(); // Start draining Serial, call after Serial.begin()
+    void poll();  // Drain Serial from loop(), for places that wait on something else. Nothing to do where an interrupt pumps
+    void pump();  // Move received bytes into the ring, only ever called from one context
+    int available();
+    int read();
+    size_t readBytes(uint8_t *buf, size_t len);
+    // Reads through terminator like Stream::readStringUntil(), keeping the first size - 1 chars in buf
+    size_t readUntil(char terminator, char *buf, size_t size);
+    void dump(); // Write stats to serial in binary and start over
+
+private:
+    EventQueue<uint8_t, RX_BUFFER> ring;
+    volatile bool started = false;
+    volatile uint16_t highWater = 0;
+    volatile uint32_t overflows = 0;
+    volatile uint32_t stalls = 0;
+    volatile uint32_t received = 0;
+    int timedRead();
+};
+
+extern SerialRx Rx;
@@ -0,0 +1,28 @@
+#include <Arduino.h>
+#define SERIAL_TX // Used to stop duplicate imports
+
+// Bytes collected before they are handed to Serial, one full speed USB packet
+#ifndef TX_BUFFER
+#define TX_BUFFER 64
+#endif
+
+/**
+ * Output side of the serial protocol. Everything printed is held until a packet's worth is collected
+ * or flush() marks a protocol boundary (right before waiting on the pc), so a reply goes out as a few
+ * full packets instead of one USB transfer per write/print call.
+ */
+class SerialTx : public Print
+{
+public:
+    size_t write(uint8_t) override;
+    size_t write(const uint8_t *, size_t) override;
+    using Print::write;
+    void flush(); // Send everything held and wait for it to leave
+
+private:
+    uint8_t buffer[TX_BUFFER];
+    uint8_t used = 0;
+    void send();
+};
+
+extern SerialTx Tx;
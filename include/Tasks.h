@@ -0,0 +1,21 @@
+#define TASKS // Used to stop duplicate imports
+
+/**
+ * The lamp's scheduler tasks as X(id, name), in the order setup() adds them, which is the order the 't' intent
+ * reports them in. tools/lampctl takes its task names from here, so a task added in setup() has to be added here too.
+ */
+#define LAMP_TASKS(X)             \
+    X(SERIAL_TASK, "serial")      \
+    X(INPUT_TASK, "input")        \
+    X(STORAGE_TASK, "storage")    \
+    X(RENDER_TASK, "render")      \
+    X(SETTINGS_TASK, "settings")  \
+    X(TRACE_TASK, "trace") // -D TRACE only
+#define LAMP_TASK_ID(id, name) id,
+#define LAMP_TASK_NAME(id, name) name,
+
+enum lampTask : unsigned char
+{
+    LAMP_TASKS(LAMP_TASK_ID)
+    LAMP_TASK_COUNT
+};
@@ -0,0 +1,50 @@
+#include <stdint.h>
+#define TRACER // Used to stop duplicate imports
+
+// Enable with -D TRACE in build_flags, compiles to nothing otherwise
+#ifdef TRACE
+#define TRACE_EVENT(type, a, b, c) Tracer::log(Tracer::type, a, b, c)
+#else
+#define TRACE_EVENT(type, a, b, c)
+#endif
+
+// Number of records held in RAM before new events get dropped
+#ifndef TRACE_BUFFER
+#if defined(MICRO) || defined(NANO)
+#define TRACE_BUFFER 32
+#else
+#define TRACE_BUFFER 128
+#endif
+#endif
+
+// Byte sent ahead of every record on the wire so the host can resync
+#define TRACE_SYNC 0xA5
+
+namespace Tracer
+{
+    // Event types, meaning of the data bytes is listed per type
+    enum eventType : uint8_t
+    {
+        FRAME_ADVANCE, // frame index, frame count, wrapped (1/0)
+        COLOR,         // r, g, b
+        MODE_CHANGE,   // new mode, old mode, -
+        EEPROM_LOAD,   // slot, frame count, -
+        EEPROM_SAVE,   // slot, frame count, -
+        DROPPED        // dropped count (low, mid, high)
+    };
+
+    // Fixed size trace record
+    struct record
+    {
+        uint8_t type;
+        uint8_t data[3];
+        uint32_t time; // micros() at time of logging
+    };
+
+    void log(eventType, uint8_t, uint8_t, uint8_t); // Append a record to the ring buffer
+    // Send as many buffered records as serial can take without blocking. Records share the port with the protocol,
+    // so only call it while no exchange with the host is in progress
+    void drain();
+    bool pending();                                 // Records waiting to be drained
+
+} // namespace Tracer
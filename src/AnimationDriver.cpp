@@ -1,11 +1,8 @@
 #include <AnimationDriver.h>
-// Debug flags
-// #define DEBUG
-// #define DEBUG_TIME
+#include <Tracer.h>
+#include <ColorMath.h>
+#include <Profiler.h>
 
-#ifdef DEBUG
-#include <Arduino.h>
-#endif
 namespace AnimationDriver
 {
 
@@ -17,6 +14,9 @@ namespace AnimationDriver
     AnimationDriver::AnimationDriver(sysTimeFunc getSysTime)
     {
         _getSysTime = getSysTime;
+#ifdef RENDER_CACHE
+        cacheLength = 0;
+#endif
     }
 
     void AnimationDriver::restart()
@@ -26,96 +26,129 @@ namespace AnimationDriver
         currentTime = 0;
     }
 
+    void AnimationDriver::seek(unsigned long t)
+    {
+        // Move the start back, updateTime() wraps t into the period on the next run()
+        lastStartTime = _getSysTime() - t;
+        currentTime = t;
+    }
+
+    void interpolate(const animFrame &last, const animFrame &next, unsigned long time, uint8_t color[3])
+    {
+        // Linearly interpolate between current and next R,G,B values, all channels in one packed lerp
+        uint16_t w = ColorMath::weight(time - last.time, next.time - last.time);
+        ColorMath::packed from = ColorMath::pack(last.color[0], last.color[1], last.color[2]);
+        ColorMath::packed to = ColorMath::pack(next.color[0], next.color[1], next.color[2]);
+        ColorMath::unpack(ColorMath::lerp(from, to, w), color);
+    }
+
+    void evaluate(const animation &anim, uint32_t t, uint8_t color[3], uint8_t *hint)
+    {
+        uint8_t count = anim.frameCount > MAX_FRAMES ? MAX_FRAMES : anim.frameCount;
+        if (count < 2)
+        {
+            // Nothing to interpolate between
+            for (uint8_t i = 0; i < 3; i++)
+                color[i] = count ? anim.frames[0].color[i] : 0;
+            return;
+        }
+        // A period only wraps once it is exceeded, so t = anim.time still shows the end of the animation
+        if (anim.time && t > anim.time)
+            t = (t - 1) % anim.time + 1;
+        // First segment that hasn't ended by t
+        uint8_t segment = hint && *hint < count - 1 && t >= anim.frames[*hint].time ? *hint : 0;
+        while (segment < count - 2 && t > anim.frames[segment + 1].time)
+            segment++;
+        if (hint)
+            *hint = segment;
+        interpolate(anim.frames[segment], anim.frames[segment + 1], t, color);
+    }
+
     // Updates private timing variables
     void AnimationDriver::updateTime()
     {
         // Set current time since last animation start
         currentTime = _getSysTime() - lastStartTime;
-#ifdef DEBUG_TIME
-        Serial.print("LastStart: ");
-        Serial.print(lastStartTime);
-        Serial.print(" Current: ");
-        Serial.print(currentTime);
-        Serial.println();
-        Serial.flush();
-#endif
-        // If the current time has reached the next frame time
-        if (currentTime > activeAnimation.frames[frameIndex + 1].time)
+        // Move the start forward by whole periods once the current one is over, however late this tick is
+        if (activeAnimation.time && currentTime > activeAnimation.time)
         {
-            frameIndex++;
-            // Frame index has passed the last frame
-            if (frameIndex == activeAnimation.frameCount-1)
-            {
-                // Move last start time forward by one animation period
-                lastStartTime += activeAnimation.time;
-                // Trim the extra animation period from current time
-                currentTime -= activeAnimation.time;
-                // Reset Frame index
-                frameIndex = 0;
-            }
+            unsigned long periods = (currentTime - 1) / activeAnimation.time;
+            lastStartTime += periods * activeAnimation.time;
+            currentTime -= periods * activeAnimation.time;
         }
-#ifdef DEBUG_TIME
-        Serial.print("Frame:");
-        Serial.print(frameIndex);
-        Serial.println();
-        Serial.flush();
-#endif
     }
 
     // Interpolates b/w frames and updates current color state
     void AnimationDriver::interpolateColor()
     {
-
-        animFrame *last = &activeAnimation.frames[frameIndex];
-        animFrame *next = &activeAnimation.frames[frameIndex + 1];
-
-#ifdef DEBUG_TIME
-        Serial.print("Last- Time: ");
-        Serial.print(last->time);
-        Serial.print(" Color: ");
-        Serial.print(last->color[2]);
-        Serial.print(" Next- Time: ");
-        Serial.print(next->time);
-        Serial.print(" Color: ");
-        Serial.print(next->color[2]);
-        Serial.println();
-        Serial.flush();
-#endif
-        // Linearly interpolate between current and next R,G,B values
-        for (uint8_t i = 0; i < 3; i++)
+        uint8_t previous = frameIndex;
+        evaluate(activeAnimation, currentTime, color, &frameIndex);
+        if (frameIndex != previous)
         {
-            color[i] = (uint8_t)((float)last->color[i] + ((float)next->color[i] - (float)last->color[i]) / ((float)next->time - (float)last->time) * (float)(currentTime - last->time));
+            TRACE_EVENT(FRAME_ADVANCE, frameIndex, activeAnimation.frameCount, frameIndex < previous);
         }
     }
 
     // Update the current animation and refresh index
-    void AnimationDriver::updateAnimation(animation newAnim)
+    void AnimationDriver::updateAnimation(const animation &newAnim)
     {
         activeAnimation = newAnim;
+#ifdef RENDER_CACHE
+        buildCache();
+#endif
         restart();
     }
 
+#ifdef RENDER_CACHE
+    // Sample one period through evaluate(), only for plain loops that fit the budget
+    void AnimationDriver::buildCache()
+    {
+        const animation &a = activeAnimation;
+        // Both ends included, updateTime() only wraps once the period is exceeded
+        uint32_t samples = a.time / RENDER_CACHE_STEP + 1;
+        cacheLength = 0;
+        if (a.time == 0 || a.frameCount < 2 || a.frameCount > MAX_FRAMES || a.frames[0].time != 0 || a.frames[a.frameCount - 1].time != a.time ||
+            samples * 3 > RENDER_CACHE_BYTES)
+        {
+            return;
+        }
+        PROFILE_BEGIN(CACHE_BUILD);
+        uint8_t segment = 0;
+        for (uint32_t i = 0; i < samples; i++)
+        {
+            evaluate(a, i * RENDER_CACHE_STEP, &cache[i * 3], &segment);
+        }
+        cacheLength = samples;
+        PROFILE_END(CACHE_BUILD);
+    }
+#endif
+
     /**
      * Runs the Animation logic based on system time and calls hardware-aware function defined in parent scope
      * @param drivingFunc the function to drive hardware, arguments passed in are (uint8_t r, uint8_t g, uint8_t b)
      */
     void AnimationDriver::run(drivingFunc runLEDs)
     {
+#ifdef RENDER_CACHE
+        if (cacheLength)
+        {
+            updateTime();
+#ifdef TRACE
+            // Only tracks the frame index so frame advances still get traced, the color comes from the cache
+            interpolateColor();
+#endif
+            const uint8_t *c = &cache[currentTime / RENDER_CACHE_STEP * 3];
+            TRACE_EVENT(COLOR, c[0], c[1], c[2]);
+            runLEDs(c[0], c[1], c[2]);
+            return;
+        }
+#endif
         // Update time-dependant variables
         updateTime();
         // Determine color state
         interpolateColor();
-// Pass color state to parent hardware-aware function
-#ifdef DEBUG
-        Serial.print("R: ");
-        Serial.print(color[0]);
-        Serial.print("G: ");
-        Serial.print(color[1]);
-        Serial.print("B: ");
-        Serial.print(color[2]);
-        Serial.println();
-        Serial.flush();
-#endif
+        TRACE_EVENT(COLOR, color[0], color[1], color[2]);
+        // Pass color state to parent hardware-aware function
         runLEDs(color[0], color[1], color[2]);
     }
 
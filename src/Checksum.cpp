@@ -0,0 +1,22 @@
+#include <Checksum.h>
+
+namespace Checksum
+{
+
+    uint16_t crc16(uint16_t crc, uint8_t data)
+    {
+        // Bitwise, a table would cost 512 bytes of flash
+        crc ^= (uint16_t)data << 8;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        return crc;
+    }
+
+    uint16_t crc16(uint16_t crc, const uint8_t *data, size_t len)
+    {
+        while (len--)
+            crc = crc16(crc, *data++);
+        return crc;
+    }
+
+} // namespace Checksum
@@ -0,0 +1,66 @@
+#include <PixelOutput.h>
+#include <Arduino.h>
+
+PixelOutput::PixelOutput(uint16_t n, int16_t pin, neoPixelType type) : Adafruit_NeoPixel(n, pin, type)
+{
+    // Everything is unknown until the first refresh
+    dirtyCount = n;
+    minInterval = 0;
+    lastShow = 0;
+}
+
+void PixelOutput::markDirty(uint16_t last)
+{
+    if (last >= dirtyCount)
+        dirtyCount = last + 1;
+}
+
+void PixelOutput::setPixelColor(uint16_t n, uint32_t c)
+{
+    if (n >= numLEDs)
+        return;
+    // Compare the stored (brightness scaled) bytes so no shadow copy of the strip is needed
+    uint8_t bytesPerPixel = numBytes / numLEDs;
+    uint8_t *p = &pixels[n * bytesPerPixel];
+    uint8_t before[4];
+    memcpy(before, p, bytesPerPixel);
+    Adafruit_NeoPixel::setPixelColor(n, c);
+    if (memcmp(before, p, bytesPerPixel) != 0)
+        markDirty(n);
+}
+
+void PixelOutput::fill(uint32_t c, uint16_t first, uint16_t count)
+{
+    uint16_t end = (count == 0 || first + count > numLEDs) ? numLEDs : first + count;
+    for (uint16_t i = first; i < end; i++)
+        setPixelColor(i, c);
+}
+
+void PixelOutput::setBrightness(uint8_t b)
+{
+    if (b == getBrightness())
+        return;
+    // Rescales every stored pixel
+    Adafruit_NeoPixel::setBrightness(b);
+    if (numLEDs)
+        markDirty(numLEDs - 1);
+}
+
+void PixelOutput::setMaxRate(uint16_t hz)
+{
+    minInterval = hz ? 1000000UL / hz : 0;
+}
+
+bool PixelOutput::update()
+{
+    if (!dirty() || (minInterval && micros() - lastShow < minInterval))
+        return false;
+    // Only clock out the chain up to the last changed pixel
+    uint16_t fullBytes = numBytes;
+    numBytes = dirtyCount * (fullBytes / numLEDs);
+    show();
+    numBytes = fullBytes;
+    lastShow = micros();
+    dirtyCount = 0;
+    return true;
+}
@@ -0,0 +1,64 @@
+#include <Profiler.h>
+
+#ifdef PROFILE
+#include <Arduino.h>
+#include <RenderTimer.h>
+#include <SerialTx.h>
+
+namespace Profiler
+{
+    static stats data;
+
+    void reset()
+    {
+        memset(&data, 0, sizeof(data));
+    }
+
+    void record(section s, uint32_t elapsed)
+    {
+        // The render tick records too
+        RENDER_HOLD();
+        sectionStats *sec = &data.sections[s];
+        // Lazily initialize on first use so no setup call is needed
+        if (sec->count == 0)
+        {
+            sec->min = elapsed;
+            sec->max = elapsed;
+        }
+        if (elapsed < sec->min)
+            sec->min = elapsed;
+        if (elapsed > sec->max)
+            sec->max = elapsed;
+        sec->total += elapsed;
+        sec->count++;
+
+        if (s == LOOP)
+        {
+            // Bucket by highest set bit
+            uint8_t bin = 0;
+            while ((elapsed >>= 1) && bin < PROFILE_HIST_BINS - 1)
+            {
+                bin++;
+            }
+            // Saturate instead of wrapping
+            if (data.loopHist[bin] != UINT16_MAX)
+                data.loopHist[bin]++;
+        }
+        RENDER_RELEASE();
+    }
+
+    /**
+     * Binary dump format (little endian):
+     * 'P', section count, histogram bin count, then the raw stats block
+     */
+    void dump()
+    {
+        Tx.write('P');
+        Tx.write((uint8_t)SECTION_COUNT);
+        Tx.write((uint8_t)PROFILE_HIST_BINS);
+        Tx.write((const uint8_t *)&data, sizeof(data));
+        Tx.flush();
+    }
+
+} // namespace Profiler
+#endif
@@ -0,0 +1,100 @@
+#include <RenderTimer.h>
+
+// The simulator provides its own tick thread
+#if defined(RENDER_TIMER) && !defined(SIM)
+#include <Arduino.h>
+
+namespace RenderTimer
+{
+    static tickFunc callback = nullptr;
+    static volatile uint8_t holds = 0;
+
+#if defined(MICRO) || defined(NANO)
+    void begin(uint16_t hz, tickFunc tick)
+    {
+        callback = tick;
+        // Timer1 in CTC mode, 16 MHz / 64 = 4 us per count (0.25 Hz resolution at 100 Hz)
+        noInterrupts();
+        TCCR1A = 0;
+        TCCR1B = _BV(WGM12) | _BV(CS11) | _BV(CS10);
+        TCNT1 = 0;
+        OCR1A = F_CPU / 64 / hz - 1;
+        TIFR1 = _BV(OCF1A);
+        if (!holds)
+            TIMSK1 |= _BV(OCIE1A);
+        interrupts();
+    }
+
+    void hold()
+    {
+        TIMSK1 &= ~_BV(OCIE1A);
+        holds++;
+    }
+
+    void release()
+    {
+        if (holds && --holds == 0 && callback)
+            TIMSK1 |= _BV(OCIE1A);
+    }
+#elif defined(XIAO)
+    static void sync()
+    {
+        while (TC3->COUNT16.STATUS.bit.SYNCBUSY)
+            ;
+    }
+
+    void begin(uint16_t hz, tickFunc tick)
+    {
+        callback = tick;
+        // TC3 in match frequency mode off the 48 MHz main clock, 48 MHz / 64 = 0.75 MHz
+        GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID_TCC2_TC3;
+        while (GCLK->STATUS.bit.SYNCBUSY)
+            ;
+        TC3->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+        sync();
+        TC3->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ | TC_CTRLA_PRESCALER_DIV64;
+        sync();
+        TC3->COUNT16.CC[0].reg = F_CPU / 64 / hz - 1;
+        sync();
+        TC3->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+        TC3->COUNT16.INTENSET.reg = TC_INTENSET_MC0;
+        // Lowest priority so USB and SysTick still preempt a render
+        NVIC_SetPriority(TC3_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+        if (!holds)
+            NVIC_EnableIRQ(TC3_IRQn);
+        TC3->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+        sync();
+    }
+
+    void hold()
+    {
+        NVIC_DisableIRQ(TC3_IRQn);
+        holds++;
+    }
+
+    void release()
+    {
+        if (holds && --holds == 0 && callback)
+            NVIC_EnableIRQ(TC3_IRQn);
+    }
+#endif
+
+} // namespace RenderTimer
+
+#if defined(MICRO) || defined(NANO)
+// A jump to 0 leaves the timer running, so the tick may fire again before begin()
+ISR(TIMER1_COMPA_vect)
+{
+    if (RenderTimer::callback)
+        RenderTimer::callback();
+}
+#elif defined(XIAO)
+void TC3_Handler()
+{
+    TC3->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+    if (RenderTimer::callback)
+        RenderTimer::callback();
+}
+#endif
+
+#endif
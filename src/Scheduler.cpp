@@ -0,0 +1,97 @@
+#include <Scheduler.h>
+#include <Arduino.h>
+#include <SerialTx.h>
+
+namespace Scheduler
+{
+    struct task
+    {
+        taskFunc run;
+        readyFunc ready;
+        uint16_t period;  // ms
+        uint8_t priority;
+        uint32_t lastRun; // millis() the current period started at
+    };
+
+    static task tasks[MAX_TASKS];
+    static taskStats stats[MAX_TASKS];
+    static uint8_t count = 0;
+    static uint32_t windowStart = 0; // micros() of the last reset
+
+    bool add(taskFunc run, uint16_t periodMs, uint8_t priority, readyFunc ready)
+    {
+        // setup() can run again without a fresh RAM image (simulated reset), replace the entry then
+        uint8_t i = 0;
+        while (i < count && tasks[i].run != run)
+            i++;
+        if (i == MAX_TASKS)
+            return false;
+        tasks[i] = task{run, ready, periodMs, priority, (uint32_t)millis()};
+        if (i == count)
+            count++;
+        return true;
+    }
+
+    static bool periodDue(const task &t, uint32_t now)
+    {
+        return t.period && now - t.lastRun >= t.period;
+    }
+
+    bool run()
+    {
+        uint32_t now = millis();
+        uint8_t next = count;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            // Only ask tasks that would win over the current pick
+            if (next < count && tasks[i].priority <= tasks[next].priority)
+                continue;
+            if (periodDue(tasks[i], now) || (tasks[i].ready && tasks[i].ready()))
+                next = i;
+        }
+        if (next == count)
+            return false;
+
+        task &t = tasks[next];
+        if (periodDue(t, now))
+        {
+            // Stay on the period grid, unless the task fell a whole period behind
+            t.lastRun = now - t.lastRun < 2UL * t.period ? t.lastRun + t.period : now;
+        }
+        uint32_t start = micros();
+        t.run();
+        uint32_t end = micros();
+        // A stats request restarts the window from inside its own task
+        if ((int32_t)(windowStart - start) > 0)
+            start = windowStart;
+
+        taskStats &s = stats[next];
+        uint32_t elapsed = end - start;
+        s.runs++;
+        s.total += elapsed;
+        if (elapsed > s.max)
+            s.max = elapsed;
+        return true;
+    }
+
+    void reset()
+    {
+        memset(stats, 0, sizeof(stats));
+        windowStart = micros();
+    }
+
+    /**
+     * Binary dump format (little endian):
+     * 'T', task count, taskStats per task, then the window length in us
+     */
+    void dump()
+    {
+        uint32_t window = micros() - windowStart;
+        Tx.write('T');
+        Tx.write(count);
+        Tx.write((const uint8_t *)stats, count * sizeof(taskStats));
+        Tx.write((const uint8_t *)&window, sizeof(window));
+        Tx.flush();
+    }
+
+} // namespace Scheduler
@@ -0,0 +1,139 @@
+#include <SerialRx.h>
+#include <SerialTx.h>
+
+SerialRx Rx;
+
+// The pump interrupt updates the stats, dump() takes them in one piece
+#ifdef RX_PUMP_ISR
+#define RX_LOCK() noInterrupts()
+#define RX_UNLOCK() interrupts()
+#else
+#define RX_LOCK()
+#define RX_UNLOCK()
+#endif
+
+void SerialRx::begin()
+{
+#ifdef RX_PUMP_ISR
+    // Timer0 already runs for millis(), compare B fires once per overflow (~1 kHz) halfway through the count
+    OCR0B = 0x80;
+    TIMSK0 |= _BV(OCIE0B);
+#endif
+    started = true;
+}
+
+void SerialRx::poll()
+{
+#ifndef RX_PUMP_ISR
+    pump();
+#endif
+}
+
+void SerialRx::pump()
+{
+    if (!started)
+        return;
+    uint8_t space = ring.space();
+    int waiting = Serial.available();
+#ifdef RX_CORE_BUFFER
+    // The core has no drop counter, a full buffer is the only sign that bytes were turned away
+    if (waiting >= (int)RX_CORE_BUFFER)
+        overflows++;
+#endif
+    while (space && waiting > 0)
+    {
+        ring.push((uint8_t)Serial.read());
+        received++;
+        space--;
+        if (--waiting == 0)
+            waiting = Serial.available();
+    }
+    if (waiting > 0)
+        stalls++;
+    uint16_t used = RX_BUFFER - 1 - space;
+    if (used > highWater)
+        highWater = used;
+}
+
+int SerialRx::available()
+{
+    poll();
+    return RX_BUFFER - 1 - ring.space();
+}
+
+int SerialRx::read()
+{
+    poll();
+    uint8_t value;
+    return ring.pop(value) ? value : -1;
+}
+
+int SerialRx::timedRead()
+{
+    uint32_t timer = millis();
+    do
+    {
+        int c = read();
+        if (c >= 0)
+            return c;
+    } while (millis() - timer < RX_TIMEOUT);
+    return -1;
+}
+
+size_t SerialRx::readBytes(uint8_t *buf, size_t len)
+{
+    size_t count = 0;
+    while (count < len)
+    {
+        int c = timedRead();
+        if (c < 0)
+            break;
+        buf[count++] = c;
+    }
+    return count;
+}
+
+size_t SerialRx::readUntil(char terminator, char *buf, size_t size)
+{
+    size_t count = 0;
+    int c = timedRead();
+    while (c >= 0 && c != terminator)
+    {
+        if (count + 1 < size)
+            buf[count++] = c;
+        c = timedRead();
+    }
+    buf[count] = 0;
+    return count;
+}
+
+/**
+ * Binary dump format (little endian):
+ * 'B', then rxStats
+ */
+void SerialRx::dump()
+{
+    rxStats stats;
+    stats.capacity = RX_BUFFER - 1;
+    RX_LOCK();
+    stats.highWater = highWater;
+    stats.overflows = overflows;
+    stats.stalls = stalls;
+    stats.received = received;
+    highWater = 0;
+    overflows = 0;
+    stalls = 0;
+    received = 0;
+    RX_UNLOCK();
+    Tx.write('B');
+    Tx.write((const uint8_t *)&stats, sizeof(stats));
+    Tx.flush();
+}
+
+#ifdef RX_PUMP_ISR
+// Non blocking so the UART's own RX interrupt can still store bytes while the pump runs
+ISR(TIMER0_COMPB_vect, ISR_NOBLOCK)
+{
+    Rx.pump();
+}
+#endif
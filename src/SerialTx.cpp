@@ -0,0 +1,44 @@
+#include <SerialTx.h>
+
+SerialTx Tx;
+
+void SerialTx::send()
+{
+    if (used)
+    {
+        Serial.write(buffer, used);
+        used = 0;
+    }
+}
+
+size_t SerialTx::write(uint8_t value)
+{
+    buffer[used++] = value;
+    if (used == TX_BUFFER)
+        send();
+    return 1;
+}
+
+size_t SerialTx::write(const uint8_t *data, size_t len)
+{
+    size_t left = len;
+    while (left)
+    {
+        size_t n = TX_BUFFER - used;
+        if (n > left)
+            n = left;
+        memcpy(&buffer[used], data, n);
+        used += n;
+        data += n;
+        left -= n;
+        if (used == TX_BUFFER)
+            send();
+    }
+    return len;
+}
+
+void SerialTx::flush()
+{
+    send();
+    Serial.flush();
+}
@@ -0,0 +1,68 @@
+#include <Tracer.h>
+
+#ifdef TRACE
+#include <Arduino.h>
+#include <RenderTimer.h>
+
+namespace Tracer
+{
+    static record buffer[TRACE_BUFFER];
+    static uint8_t head = 0; // Next slot to write
+    static uint8_t tail = 0; // Next slot to send
+    static uint8_t count = 0;
+    static uint32_t dropped = 0; // Events lost since the last dropped record
+
+    static void push(eventType type, uint8_t a, uint8_t b, uint8_t c)
+    {
+        record *rec = &buffer[head];
+        rec->type = type;
+        rec->data[0] = a;
+        rec->data[1] = b;
+        rec->data[2] = c;
+        rec->time = micros();
+        head = (head + 1) % TRACE_BUFFER;
+        count++;
+    }
+
+    void log(eventType type, uint8_t a, uint8_t b, uint8_t c)
+    {
+        // The render tick logs too
+        RENDER_HOLD();
+        // Keep one slot free so a dropped record can always be emitted once space frees up
+        if (count >= TRACE_BUFFER - 1)
+        {
+            dropped++;
+        }
+        else
+        {
+            if (dropped)
+            {
+                push(DROPPED, (uint8_t)dropped, (uint8_t)(dropped >> 8), (uint8_t)(dropped >> 16));
+                dropped = 0;
+            }
+            push(type, a, b, c);
+        }
+        RENDER_RELEASE();
+    }
+
+    bool pending()
+    {
+        return count != 0;
+    }
+
+    void drain()
+    {
+        // Only send whole records, never wait on the serial port
+        while (count && Serial.availableForWrite() > (int)sizeof(record))
+        {
+            Serial.write((uint8_t)TRACE_SYNC);
+            Serial.write((const uint8_t *)&buffer[tail], sizeof(record));
+            tail = (tail + 1) % TRACE_BUFFER;
+            RENDER_HOLD();
+            count--;
+            RENDER_RELEASE();
+        }
+    }
+
+} // namespace Tracer
+#endif
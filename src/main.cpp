@@ -9,15 +9,29 @@
  */
 
 #include <Arduino.h>
+#include <stddef.h>
 
 #if defined(MICRO) || defined(NANO)
 #include <EEPROM.h>
+#ifndef SIM
+#include <avr/wdt.h>
+#endif
 #else
 #include <extEEPROM.hpp>
 #endif
-#include <Adafruit_NeoPixel.h>
+#include <PixelOutput.h>
 #include <AnimationDriver.h>
 #include <DefaultAnimations.h>
+#include <Profiler.h>
+#include <Tracer.h>
+#include <SerialTx.h>
+#include <Checksum.h>
+#include <FastPin.h>
+#include <RenderTimer.h>
+#include <Scheduler.h>
+#include <EventQueue.h>
+#include <SerialRx.h>
+#include <Tasks.h>
 
 //#define WRITE_EEPROM // Flag to write defaults to EEPROM (effectively reset EEPROM)
 // #define SKIP_PIXEL // Skip the first pixel for the 3.3v hack
@@ -37,6 +51,7 @@
 #define PIXEL_PIN 10
 #define BTN_UP_PIN 5
 #define BTN_DWN_PIN 7
+#define STORAGE_SIZE 1024 // Internal EEPROM
 #endif
 
 #ifdef NANO
@@ -44,6 +59,7 @@
 #define PIXEL_PIN 2
 #define BTN_UP_PIN 3
 #define BTN_DWN_PIN 4
+#define STORAGE_SIZE 1024 // Internal EEPROM
 #endif
 
 #ifdef XIAO
@@ -51,16 +67,28 @@
 #define PIXEL_PIN 10  // D10
 #define BTN_UP_PIN 9  // D9
 #define BTN_DWN_PIN 8 // D8
+#define STORAGE_SIZE 2048 // 24AA16H (8192 for the 24FC64F)
 #endif
 
 // Numerical Constants
 // #define T_LOOP 0     // Execution loop time
 // Serial Constants
-#define SERIAL_PACKET 142
 #define FRAME_SIZE 7
 #define META_SIZE 2
+#define SERIAL_TIMEOUT 1000
+#define ANIM_SLOTS 6
+#define STORAGE_PAGE 16 // Bytes per storage write on image restore, one 24AA16H page
+#define IMAGE_CREDIT 0x11 // XON, sent when the lamp is ready for the next page of an image restore
 #define POT_THRES 20
+#define MAX_SHOW_RATE 0 // Strip refreshes per second, 0 for no cap (long strips take ~30us per pixel)
 #define BTN_TIME 200
+#define INPUT_PERIOD 10  // ms between pot/button polls
+#define RENDER_PERIOD 10 // ms between frames without RENDER_TIMER
+#define SETTINGS_ADDR (ANIM_SLOTS * sizeof(AnimationDriver::animation)) // Settings record, right after the slots
+#define SETTINGS_MAGIC 0x5A
+#define SETTINGS_DELAY 5000 // ms a setting has to stay the same before it is written
+#define SNAPSHOT_MAGIC 0x4C4D // "LM", marks a resume snapshot
+#define TRACE_QUIET 250 // ms the host has to stay silent after a request before trace records are sent
 
 #ifdef XIAO
 extEEPROM EEPROM(0b1010000, extEEPROM::deviceIDs::ID_24AA16H);
@@ -68,28 +96,12 @@ extEEPROM EEPROM(0b1010000, extEEPROM::deviceIDs::ID_24AA16H);
 #endif
 
 // unsigned long loopTimer;
-Adafruit_NeoPixel strip(NUM_LEDS, PIXEL_PIN, NEO_GRB + NEO_KHZ800);
+PixelOutput strip(NUM_LEDS, PIXEL_PIN, NEO_GRB + NEO_KHZ800);
 
 AnimationDriver::AnimationDriver animator(millis);
-// Default animations
-
-// Note animation size is 168 bytes & eeprom is 1kB
-const AnimationDriver::animation Solid_White PROGMEM = SOLID_COLOR(255, 255, 255);
-const AnimationDriver::animation Solid_Red PROGMEM = SOLID_COLOR(255, 0, 0);
-const AnimationDriver::animation Breathe_White PROGMEM = BREATHE_COLOR(255, 255, 255, 3000UL);
-const AnimationDriver::animation Solid_Green PROGMEM = SOLID_COLOR(0, 255, 0);
-const AnimationDriver::animation Rainbow PROGMEM = RAINBOW(4000UL);
-const AnimationDriver::animation Solid_Blue PROGMEM = SOLID_COLOR(0, 0, 255);
-
-const AnimationDriver::animation defaults[] PROGMEM = {
-    Solid_White,
-    Solid_Red,
-    Breathe_White,
-    Solid_Green,
-    Rainbow,
-    Solid_Blue};
-
-AnimationDriver::animation currentAnim;
+
+// Outside .bss so a previewed animation, which only lives here, survives a soft reset
+AnimationDriver::animation currentAnim __attribute__((section(".noinit")));
 
 // Current and previous values for LED brightness (used to only change brightness when needed)
 uint16_t LEDscale;
@@ -97,8 +109,177 @@ uint16_t prevLEDScale;
 
 uint32_t btnTimer = 0;
 
-// Function used for resetting programmatically
-void (*resetFunc)(void) = 0;
+// Posted by the input and serial tasks, applied by the render task once per frame
+EventQueue<Events::event, EVENT_QUEUE_SIZE> events;
+
+uint8_t currentMode = 0;  // Slot picked with the buttons
+bool loadPending = false; // currentMode has to be (re)loaded by the storage task
+
+// User state kept across power cycles
+struct settingsRecord
+{
+  uint8_t magic;
+  uint8_t slot;       // Last picked mode
+  uint8_t brightness; // Strip brightness
+  uint8_t rate;       // Playback speed in percent, reserved (always 100 for now)
+  uint16_t crc;       // CRC16 of everything above
+};
+static_assert(SETTINGS_ADDR + sizeof(settingsRecord) <= STORAGE_SIZE, "settings record doesn't fit in storage");
+
+settingsRecord settings = {SETTINGS_MAGIC, 0, 0, 100, 0}; // Live values
+settingsRecord savedSettings __attribute__((section(".noinit"))); // What storage holds, kept across soft resets
+uint32_t settingsChanged = 0;                             // millis() of the last change
+
+// Set while currentAnim holds a previewed animation that only lives in RAM, storage reloads leave it playing
+bool previewActive = false;
+uint8_t previewSlot = 0; // Slot a commit request stores the preview in
+
+#ifdef RENDER_TIMER
+// Colors handed from the render tick to loop(), the tick fills the back buffer then publishes it
+volatile uint8_t frameColor[2][3];
+volatile uint8_t frontFrame = 0; // Buffer loop() may read
+volatile uint8_t frameSeq = 0;   // Bumped on every publish
+uint8_t shownSeq = 0;            // Last frame loop() showed
+#endif
+
+// Playback state that survives a soft reset, in RAM the C runtime leaves alone at startup
+struct resumeSnapshot
+{
+  uint16_t magic;
+  uint8_t slot; // currentMode
+  uint8_t brightness;
+  uint8_t preview;  // previewSlot, PREVIEW_END if no preview was playing
+  uint16_t animCrc; // CRC16 of currentAnim as last played, a preview is only resumed if it still matches
+  uint16_t crc;     // CRC16 of everything above
+  // Rewritten every frame, so it has its own check instead of redoing the CRC
+  uint32_t phase; // ms into anim at the last frame
+  uint32_t phaseCheck; // ~phase
+};
+resumeSnapshot snapshot __attribute__((section(".noinit")));
+
+#ifdef SIM
+void resetFunc(); // Provided by the host simulator
+#endif
+
+uint16_t animCrc()
+{
+  return Checksum::crc16(CRC16_INIT, (const uint8_t *)&currentAnim, sizeof(currentAnim));
+}
+
+// Refresh the CRC covered part of the snapshot, after anything in it changed
+void saveSnapshot()
+{
+  snapshot.magic = SNAPSHOT_MAGIC;
+  snapshot.slot = currentMode;
+  snapshot.brightness = settings.brightness;
+  snapshot.preview = previewActive ? previewSlot : PREVIEW_END;
+  snapshot.crc = Checksum::crc16(CRC16_INIT, (const uint8_t *)&snapshot, offsetof(resumeSnapshot, crc));
+}
+
+// Record how far into the animation the last frame was
+void savePhase(uint32_t phase)
+{
+  snapshot.phase = phase;
+  snapshot.phaseCheck = ~phase;
+}
+
+// True if the snapshot survived a reset intact
+bool snapshotValid()
+{
+  return snapshot.magic == SNAPSHOT_MAGIC && snapshot.crc == Checksum::crc16(CRC16_INIT, (const uint8_t *)&snapshot, offsetof(resumeSnapshot, crc)) &&
+         snapshot.phaseCheck == ~snapshot.phase && snapshot.slot < sizeof(defaults) / sizeof(AnimationDriver::animation);
+}
+
+// Restart the chip through the watchdog (AVR) or a system reset request (SAMD), playback resumes from the snapshot
+void softReset()
+{
+#if defined(SIM)
+  resetFunc();
+#elif defined(XIAO)
+  NVIC_SystemReset();
+#else
+  wdt_enable(WDTO_15MS);
+  for (;;)
+    ;
+#endif
+}
+
+#if (defined(MICRO) || defined(NANO)) && !defined(SIM)
+// The watchdog stays armed after it resets the chip, disarm it before it can fire again during setup()
+void wdtOff() __attribute__((naked, used, section(".init3")));
+void wdtOff()
+{
+  MCUSR = 0;
+  wdt_disable();
+}
+#endif
+
+// Output stage, pushes a rendered color to the strip
+void showColor(uint8_t r, uint8_t g, uint8_t b)
+{
+#ifdef SKIP_PIXEL
+  strip.fill(strip.Color(r, g, b), 1, 0); // Fill strip, skipping first pixel
+#else
+  strip.fill(strip.Color(r, g, b)); // Fill entire strip
+#endif
+  // Only refreshes when the fill changed something
+  PROFILE_BEGIN(SHOW);
+  strip.update();
+  PROFILE_END(SHOW);
+}
+
+// Loads currentAnim into the driver, the render tick is held off so it never sees a half copied animation
+void playAnimation()
+{
+  RENDER_HOLD();
+  animator.updateAnimation(currentAnim);
+  RENDER_RELEASE();
+  snapshot.animCrc = animCrc();
+  savePhase(0);
+  saveSnapshot();
+}
+
+// Queues an event for the render task, serialReady() makes sure a request finds room for its events
+void post(Events::eventType type, uint8_t value)
+{
+  events.push(Events::event{type, value});
+}
+
+#ifdef RENDER_TIMER
+// Runs from the timer interrupt at RENDER_RATE, only renders, the strip is driven from loop()
+void renderTick()
+{
+  PROFILE_INTERVAL(FRAME);
+  PROFILE_BEGIN(RUN);
+  animator.run([](uint8_t r, uint8_t g, uint8_t b)
+               {
+                 uint8_t back = frontFrame ^ 1;
+                 frameColor[back][0] = r;
+                 frameColor[back][1] = g;
+                 frameColor[back][2] = b;
+                 frontFrame = back;
+                 frameSeq++; });
+  PROFILE_END(RUN);
+}
+
+// Shows the latest published frame, if there is a new one
+void showFrame()
+{
+  uint8_t seq, color[3];
+  // Lock free snapshot, copy again if a tick published while copying
+  do
+  {
+    seq = frameSeq;
+    if (seq == shownSeq)
+      return;
+    uint8_t front = frontFrame;
+    for (uint8_t i = 0; i < 3; i++)
+      color[i] = frameColor[front][i];
+  } while (seq != frameSeq);
+  shownSeq = seq;
+  showColor(color[0], color[1], color[2]);
+}
+#endif
 
 // Load specific animation from eeprom into currentAnim
 void EEPROM_Load(uint8_t index)
@@ -112,9 +293,9 @@ void EEPROM_Load(uint8_t index)
 #ifdef XIAO
   EEPROM.get((uint32_t)(index * sizeof(AnimationDriver::animation)), &currentAnim, sizeof(AnimationDriver::animation));
 #else
-  const AnimationDriver::animation* animPtr = &currentAnim;
-  EEPROM.get((int)(index * sizeof(AnimationDriver::animation)), animPtr);
+  EEPROM.get((int)(index * sizeof(AnimationDriver::animation)), currentAnim);
 #endif
+  TRACE_EVENT(EEPROM_LOAD, index, currentAnim.frameCount, 0);
 #ifdef DEBUG_EEPROM
   Serial.println(currentAnim.frameCount);
   Serial.println("Animation Loaded");
@@ -122,6 +303,73 @@ void EEPROM_Load(uint8_t index)
 #endif
 }
 
+// Read a run of bytes from eeprom
+void EEPROM_Read(uint32_t addr, uint8_t *data, size_t len)
+{
+#ifdef XIAO
+  EEPROM.get(addr, data, len);
+#else
+  for (size_t i = 0; i < len; i++)
+  {
+    data[i] = EEPROM.read(addr + i);
+  }
+#endif
+}
+
+// Write a run of bytes to eeprom, unchanged bytes are skipped on AVR
+void EEPROM_Write(uint32_t addr, uint8_t *data, size_t len)
+{
+#ifdef XIAO
+  EEPROM.put(addr, data, len);
+#else
+  for (size_t i = 0; i < len; i++)
+  {
+    EEPROM.update(addr + i, data[i]);
+    Rx.poll(); // Each changed byte takes ~3.3 ms, keep taking in the next page meanwhile
+  }
+#endif
+}
+
+// Store currentAnim in a slot, only the frames in use are written
+void EEPROM_Save(uint8_t index, AnimationDriver::animation &anim)
+{
+  uint32_t base = index * sizeof(AnimationDriver::animation);
+  EEPROM_Write(base, (uint8_t *)anim.frames, anim.frameCount * sizeof(AnimationDriver::animFrame));
+  // frameCount and time
+  const size_t header = offsetof(AnimationDriver::animation, frameCount);
+  EEPROM_Write(base + header, (uint8_t *)&anim + header, sizeof(AnimationDriver::animation) - header);
+  TRACE_EVENT(EEPROM_SAVE, index, anim.frameCount, 0);
+}
+
+// CRC of a settings record, the crc field itself excluded
+uint16_t settingsCrc(const settingsRecord &record)
+{
+  return Checksum::crc16(CRC16_INIT, (const uint8_t *)&record, offsetof(settingsRecord, crc));
+}
+
+// Read the settings record, false if storage holds none (blank, corrupt or out of range)
+bool EEPROM_LoadSettings()
+{
+  EEPROM_Read(SETTINGS_ADDR, (uint8_t *)&savedSettings, sizeof(savedSettings));
+  if (savedSettings.magic != SETTINGS_MAGIC || savedSettings.crc != settingsCrc(savedSettings))
+    return false;
+  // A record from another layout can pass its CRC and still name a slot that doesn't exist
+  if (savedSettings.slot >= sizeof(defaults) / sizeof(AnimationDriver::animation))
+    return false;
+  settings = savedSettings;
+  return true;
+}
+
+// Write the live settings if they differ from what storage holds
+void EEPROM_SaveSettings()
+{
+  settings.crc = settingsCrc(settings);
+  if (memcmp(&settings, &savedSettings, sizeof(settings)) == 0)
+    return;
+  EEPROM_Write(SETTINGS_ADDR, (uint8_t *)&settings, sizeof(settings));
+  savedSettings = settings;
+}
+
 // Write defaults to eeprom
 void EEPROM_WriteDefaults()
 {
@@ -141,7 +389,7 @@ void EEPROM_WriteDefaults()
 #ifdef XIAO
     EEPROM.put((uint32_t)(i * sizeof(AnimationDriver::animation)), &animBuff, sizeof(AnimationDriver::animation));
 #else
-    EEPROM.put((int)(i * sizeof(AnimationDriver::animation)), &animBuff);
+    EEPROM.put((int)(i * sizeof(AnimationDriver::animation)), animBuff);
 #endif
   }
   Serial.println("DEFAULTS WRITTEN TO EEPROM");
@@ -150,43 +398,50 @@ void EEPROM_WriteDefaults()
 
 // Serial Methods
 
-// Parse out an animation object from a serial buffer and store in EEPROM
-void saveAnimationFromSerial(byte *buff)
+// Waits until count bytes are buffered, false on timeout
+bool waitForBytes(uint8_t count, uint32_t timeout)
 {
-  AnimationDriver::animation _a;
-  _a.frameCount = buff[1];
-  // For each frame
-  for (byte i = 0; i < buff[1]; i++)
+  uint32_t timer = millis();
+  while (Rx.available() < count)
   {
-    byte baseIndex = i * FRAME_SIZE + 2;
-    _a.frames[i].color[0] = buff[baseIndex];                                                                                                                            // Red
-    _a.frames[i].color[1] = buff[baseIndex + 1];                                                                                                                        // Green
-    _a.frames[i].color[2] = buff[baseIndex + 2];                                                                                                                        // Blue
-    _a.frames[i].time = (uint32_t)buff[baseIndex + 3] << 24 | (uint32_t)buff[baseIndex + 4] << 16 | (uint32_t)buff[baseIndex + 5] << 8 | (uint32_t)buff[baseIndex + 6]; // time
-    if (i == buff[1] - 1)
+    if (millis() - timer > timeout)
     {
-      _a.time = _a.frames[i].time;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Throw away whatever the pc is still sending after a rejected request, until the line goes quiet
+void discardInput()
+{
+  // Echoes still queued would only get answered after the line went quiet, send them first
+  Tx.flush();
+  uint32_t timer = millis();
+  while (millis() - timer < 50)
+  {
+    if (Rx.available() > 0)
+    {
+      Rx.read();
+      timer = millis();
     }
   }
-#ifdef XIAO
-  EEPROM.put((buff[0] * sizeof(AnimationDriver::animation)), &_a, sizeof(AnimationDriver::animation));
-#else
-  EEPROM.put(buff[0] * sizeof(AnimationDriver::animation), _a);
-#endif
 }
 
 // Waits for acknowledge byte (0xff) from pc
 bool waitForAck(uint32_t timeout)
 {
+  // The pc only answers what it has received
+  Tx.flush();
   // Start timer
   uint32_t timer = millis();
   //  Serial.println(F("Waiting for ACK"));
   while (true)
   {
     // Check for Serial data or
-    if (Serial.available() > 0)
+    if (Rx.available() > 0)
     {
-      uint8_t ack = (uint8_t)Serial.read();
+      uint8_t ack = (uint8_t)Rx.read();
       if (ack == 0xff)
       {
         // Success
@@ -195,136 +450,302 @@ bool waitForAck(uint32_t timeout)
       else
       {
         // fail
-        Serial.println(F("ACK Fail"));
-        Serial.flush();
+        Tx.println(F("ACK Fail"));
+        Tx.flush();
         return false;
       }
     }
     // Check if timer has ran out
     else if (millis() - timer > timeout)
     {
-      Serial.println(F("ACK Fail"));
-      Serial.flush();
+      Tx.println(F("ACK Fail"));
+      Tx.flush();
       return false;
     }
   }
 }
 
-// Handle an an upload request
-void handleUploadRequest()
+// Read one byte and queue its echo, Tx sends the echo in full packets rather than a transfer per byte. False on timeout
+bool echoByte(uint8_t &value)
 {
-  byte localBuff[SERIAL_PACKET];
-  byte buffCount = META_SIZE;
-  // Wait for first 2 bytes to come in
-  while (Serial.available() < META_SIZE)
-    ;
-#ifdef XIAO
-  Serial.readBytes((char *)localBuff, META_SIZE);
-#else
-  Serial.readBytes(localBuff, META_SIZE);
-#endif
+  if (!waitForBytes(1, SERIAL_TIMEOUT))
+  {
+    return false;
+  }
+  value = (uint8_t)Rx.read();
+  Tx.write(value);
+  return true;
+}
 
-  // While the pc is sending data, store it in the buffer
-  // Loop untill all bytes expected are read
-  while (buffCount < (localBuff[1] * FRAME_SIZE + META_SIZE))
+/**
+ * Decode frames into anim as they arrive, echoing every byte back to the pc
+ * Frame times have to increase, the driver divides by the gap between frames
+ * @return false on timeout, valid is cleared if a frame was rejected (the rest is still read and echoed)
+ */
+bool receiveFrames(AnimationDriver::animation &anim, uint8_t frameCount, bool &valid)
+{
+  valid = true;
+  for (uint8_t i = 0; i < frameCount; i++)
   {
-    // Let a byte come in
-    while (Serial.available() < 1)
-      ;
-    if (buffCount <= SERIAL_PACKET)
+    AnimationDriver::animFrame &frame = anim.frames[i];
+    for (uint8_t c = 0; c < 3; c++)
+    {
+      if (!echoByte(frame.color[c]))
+      {
+        return false;
+      }
+    }
+    // Big endian time
+    frame.time = 0;
+    for (uint8_t b = 0; b < 4; b++)
     {
-      // Append to buffer
-      byte data = (byte)Serial.read();
-      localBuff[buffCount] = data;
-      buffCount++;
+      uint8_t value;
+      if (!echoByte(value))
+      {
+        return false;
+      }
+      frame.time = frame.time << 8 | value;
     }
-    // Writing outside buffer space, send an error back
-    else
+    if (i > 0 && frame.time <= anim.frames[i - 1].time)
     {
-      Serial.println();
-      return;
+      valid = false;
     }
   }
-  // Once all the data has been received, write it back to the pc
-  Serial.write(localBuff, buffCount);
+  anim.frameCount = frameCount;
+  anim.time = anim.frames[frameCount - 1].time;
+  return true;
+}
+
+// Handle an an upload request
+// Frames are decoded on the stack and only used once the pc acknowledged them, a failed upload leaves currentAnim alone
+// An upload goes straight to storage, a preview is copied into currentAnim and played from RAM until a commit request
+void handleUploadRequest(bool preview)
+{
+  byte meta[META_SIZE];
+  AnimationDriver::animation incoming;
+  // Wait for first 2 bytes to come in
+  if (!waitForBytes(META_SIZE, SERIAL_TIMEOUT))
+  {
+    Tx.println();
+    return;
+  }
+  Rx.readBytes(meta, META_SIZE);
+
+  // Reject anything that doesn't fit a slot before reading frames, the driver also needs 2 frames to interpolate
+  if (meta[0] >= ANIM_SLOTS || meta[1] < 2 || meta[1] > MAX_FRAMES)
+  {
+    discardInput();
+    Tx.println();
+    return;
+  }
+  Tx.write(meta, META_SIZE);
+
+  // Send an error back if the pc stops sending
+  bool valid;
+  if (!receiveFrames(incoming, meta[1], valid))
+  {
+    Tx.println();
+    return;
+  }
+  if (!valid)
+  {
+    discardInput();
+    Tx.println();
+    return;
+  }
   // Read a check character (0x00 -> fail, 0xff -> success)
   if (waitForAck(1000))
   {
     // Success
-    // Store data in memory if check character came back okay
-    saveAnimationFromSerial(localBuff);
+    if (preview)
+    {
+      // Played from the next frame on, storage is left alone. The driver has its own copy, so this can't tear a frame
+      currentAnim = incoming;
+      post(Events::PREVIEW, meta[0]);
+    }
+    else
+    {
+      // Store data in memory if check character came back okay
+      EEPROM_Save(meta[0], incoming);
+      post(Events::SLOT_UPDATED, meta[0]);
+    }
     // Send one more string back to indicate write finished
-    Serial.println(F("Done"));
-    Serial.flush();
+    Tx.println(F("Done"));
+    Tx.flush();
   }
   else
   {
-    resetFunc();
+    softReset();
   }
 }
 
+// Handle a request to keep the animation being previewed
+void handleCommitRequest()
+{
+  if (!previewActive)
+  {
+    Tx.println();
+    return;
+  }
+  EEPROM_Save(previewSlot, currentAnim);
+  // Stored now, so it is no longer a RAM-only preview and the selected slot plays from storage again
+  previewActive = false;
+  post(Events::PREVIEW, PREVIEW_END);
+  post(Events::SLOT_UPDATED, previewSlot);
+  Tx.println(F("Done"));
+}
+
 // Handle request for download
+// Frames are read from storage one at a time, so stack use doesn't depend on the slot
 void handleDownloadRequest()
 {
-  for (uint8_t i = 0; i < 6; i++)
+  for (uint8_t i = 0; i < ANIM_SLOTS; i++)
   {
-    AnimationDriver::animation _a;
-#ifdef XIAO
-    EEPROM.get((i * sizeof(AnimationDriver::animation)), &_a, sizeof(AnimationDriver::animation));
-#else
-    EEPROM.get(i * sizeof(AnimationDriver::animation), _a);
-#endif
+    uint32_t base = i * sizeof(AnimationDriver::animation);
+    uint8_t frameCount;
+    EEPROM_Read(base + offsetof(AnimationDriver::animation, frameCount), &frameCount, 1);
+    // Never send more than a slot can hold, even if storage is corrupt
+    if (frameCount > MAX_FRAMES)
+    {
+      frameCount = MAX_FRAMES;
+    }
     // Write the frame count
     if (!waitForAck(1000))
     {
-      resetFunc();
+      softReset();
     }
-    Serial.write(i);
-    Serial.write(_a.frameCount);
-    Serial.flush();
+    Tx.write(i);
+    Tx.write(frameCount);
     // Wait for an acknowledge or timeout
     if (!waitForAck(1000))
     {
-      resetFunc();
+      softReset();
     }
-    // Send rest of animation frames
-    // Parse animation object into uint8_t array
-    uint8_t frameBuff[_a.frameCount * FRAME_SIZE];
-    for (uint8_t frame = 0; frame < _a.frameCount; frame++)
+    // Send rest of animation frames, Tx packs them into full packets
+    for (uint8_t frame = 0; frame < frameCount; frame++)
     {
-      uint8_t baseIndex = frame * FRAME_SIZE;
-      // Red
-      frameBuff[baseIndex] = _a.frames[frame].color[0];
-      // Green
-      frameBuff[baseIndex + 1] = _a.frames[frame].color[1];
-      // Blue
-      frameBuff[baseIndex + 2] = _a.frames[frame].color[2];
+      AnimationDriver::animFrame f;
+      EEPROM_Read(base + frame * sizeof(AnimationDriver::animFrame), (uint8_t *)&f, sizeof(f));
+      uint8_t out[FRAME_SIZE];
+      // Red, Green, Blue
+      out[0] = f.color[0];
+      out[1] = f.color[1];
+      out[2] = f.color[2];
       // Timestamp (four bytes)
-      frameBuff[baseIndex + 3] = (uint8_t)(_a.frames[frame].time >> 24);
-      frameBuff[baseIndex + 4] = (uint8_t)(_a.frames[frame].time >> 16);
-      frameBuff[baseIndex + 5] = (uint8_t)(_a.frames[frame].time >> 8);
-      frameBuff[baseIndex + 6] = (uint8_t)(_a.frames[frame].time);
+      out[3] = (uint8_t)(f.time >> 24);
+      out[4] = (uint8_t)(f.time >> 16);
+      out[5] = (uint8_t)(f.time >> 8);
+      out[6] = (uint8_t)(f.time);
+      Tx.write(out, FRAME_SIZE);
     }
-    // Send buffer
-    Serial.write(frameBuff, _a.frameCount * FRAME_SIZE);
-    Serial.flush();
     // Wait for acknowledge or timeout
     if (!waitForAck(1000))
     {
-      resetFunc();
+      softReset();
     }
   }
 }
 
+// Handle a request for the raw storage image
+// Size (2 bytes, big endian), every byte of storage, then the CRC16 of the image (big endian), all in one burst
+void handleImageReadRequest()
+{
+  uint8_t page[STORAGE_PAGE];
+  uint16_t crc = CRC16_INIT;
+  Tx.write((uint8_t)(STORAGE_SIZE >> 8));
+  Tx.write((uint8_t)STORAGE_SIZE);
+  for (uint32_t addr = 0; addr < STORAGE_SIZE; addr += STORAGE_PAGE)
+  {
+    EEPROM_Read(addr, page, STORAGE_PAGE);
+    crc = Checksum::crc16(crc, page, STORAGE_PAGE);
+    Tx.write(page, STORAGE_PAGE);
+  }
+  Tx.write((uint8_t)(crc >> 8));
+  Tx.write((uint8_t)crc);
+}
+
+/**
+ * Handle a raw storage image restore
+ * The pc sends the size and gets the page size back, then sends one page each time it gets a credit byte,
+ * then the CRC16 of the image.
+ * The credit for the next page goes out before the current one is written, so a page is always in flight
+ * but never more than the receive buffer can hold. The CRC is checked against what reads back from storage
+ */
+void handleImageWriteRequest()
+{
+  uint8_t page[STORAGE_PAGE];
+  // Every slot is about to change
+  if (previewActive)
+  {
+    previewActive = false;
+    post(Events::PREVIEW, PREVIEW_END);
+  }
+  if (!waitForBytes(2, SERIAL_TIMEOUT))
+  {
+    Tx.println();
+    return;
+  }
+  uint16_t size = (uint16_t)Rx.read() << 8;
+  size |= (uint8_t)Rx.read();
+  if (size != STORAGE_SIZE)
+  {
+    discardInput();
+    Tx.println();
+    return;
+  }
+  // The page size doubles as the credit for the first page
+  Tx.write((uint8_t)STORAGE_PAGE);
+  Tx.flush();
+  // Even a restore that breaks off halfway has changed storage
+  post(Events::SLOT_UPDATED, ALL_SLOTS);
+  for (uint32_t addr = 0; addr < STORAGE_SIZE; addr += STORAGE_PAGE)
+  {
+    if (!waitForBytes(STORAGE_PAGE, SERIAL_TIMEOUT))
+    {
+      Tx.println();
+      return;
+    }
+    Rx.readBytes(page, STORAGE_PAGE);
+    if (addr + STORAGE_PAGE < STORAGE_SIZE)
+    {
+      Tx.write(IMAGE_CREDIT);
+      Tx.flush();
+    }
+    EEPROM_Write(addr, page, STORAGE_PAGE);
+  }
+  if (!waitForBytes(2, SERIAL_TIMEOUT))
+  {
+    Tx.println();
+    return;
+  }
+  uint16_t expected = (uint16_t)Rx.read() << 8;
+  expected |= (uint8_t)Rx.read();
+  uint16_t crc = CRC16_INIT;
+  for (uint32_t addr = 0; addr < STORAGE_SIZE; addr += STORAGE_PAGE)
+  {
+    EEPROM_Read(addr, page, STORAGE_PAGE);
+    crc = Checksum::crc16(crc, page, STORAGE_PAGE);
+  }
+  if (crc == expected)
+  {
+    Tx.println(F("Done"));
+  }
+  else
+  {
+    Tx.println(F("CRC Fail"));
+  }
+}
+
 // Handle overall Serial Communication
 void handleSerial()
 {
-  // Read until code ends
-  String code = Serial.readStringUntil('-');
+  // Read until code ends, codes are a single char so anything past the buffer is only consumed
+  char code[8];
+  Rx.readUntil('-', code, sizeof(code));
   // Echo Back a ready string and acknowledge the code received
-  Serial.print(F("ready_"));
-  Serial.println(code);
-  Serial.flush();
+  Tx.print(F("ready_"));
+  Tx.println(code);
+  Tx.flush();
   // Do something useful with the intent code
   switch (code[0])
   {
@@ -334,15 +755,45 @@ void handleSerial()
   case '3':
   case '4':
   case '5':
-    handleUploadRequest();
+    handleUploadRequest(false);
+    break;
+  case 'p':
+    handleUploadRequest(true);
+    break;
+  case 'c':
+    handleCommitRequest();
+    break;
+  case 'r':
+    handleImageReadRequest();
+    break;
+  case 'w':
+    handleImageWriteRequest();
     break;
   case 'd':
     handleDownloadRequest();
     break;
+  case 't':
+    // Dump task run times and start a fresh measurement window
+    Scheduler::dump();
+    Scheduler::reset();
+    break;
+  case 'b':
+    // Dump receive ring fill level and overflows, then start counting over
+    Rx.dump();
+    break;
+#ifdef PROFILE
+  case 's':
+    // Dump profiler stats and start a fresh measurement window
+    Profiler::dump();
+    Profiler::reset();
+    break;
+#endif
   default:
-    Serial.println();
+    Tx.println();
     break;
   }
+  // End of the request, nothing may stay behind
+  Tx.flush();
 }
 
 // DEBUG Functions
@@ -377,7 +828,8 @@ void EEPROM_Dump_Anim(uint8_t index)
   }
 }
 #endif
-uint16_t buttonFSM()
+// Returns 1 once per press of the up button, -1 per press of the down button and 0 otherwise
+int8_t buttonFSM()
 {
   enum state
   {
@@ -388,19 +840,19 @@ uint16_t buttonFSM()
   static state currentState = IDLE;
   static bool changeUP = false;
   static uint32_t timer = 0;
-  static uint16_t outputMode = 0;
+  int8_t step = 0;
 
   switch (currentState)
   {
   case IDLE:
-    if (!digitalRead(BTN_UP_PIN))
+    if (!FastPin<BTN_UP_PIN>::read())
     {
       currentState = TRIGGERED;
       changeUP = true;
       timer = millis();
       break;
     }
-    if (!digitalRead(BTN_DWN_PIN))
+    if (!FastPin<BTN_DWN_PIN>::read())
     {
       currentState = TRIGGERED;
       changeUP = false;
@@ -413,44 +865,224 @@ uint16_t buttonFSM()
     if (millis() - timer > BTN_TIME) // timer passes
     {
       // If output is still appropriate, make changes
-      if (changeUP && !digitalRead(BTN_UP_PIN))
+      if (changeUP && !FastPin<BTN_UP_PIN>::read())
       {
-        outputMode = (outputMode + 1) % (sizeof(defaults) / sizeof(AnimationDriver::animation));
+        step = 1;
       }
-      else if (!changeUP && !digitalRead(BTN_DWN_PIN))
+      else if (!changeUP && !FastPin<BTN_DWN_PIN>::read())
       {
-        if (outputMode < 1)
-        {
-          outputMode = sizeof(defaults) / sizeof(AnimationDriver::animation) - 1;
-        }
-        else
-        {
-          outputMode--;
-        }
+        step = -1;
       }
       currentState = RELEASE;
     }
     break;
 
   case RELEASE:
-    if (digitalRead(BTN_UP_PIN) && digitalRead(BTN_DWN_PIN))
+    if (FastPin<BTN_UP_PIN>::read() && FastPin<BTN_DWN_PIN>::read())
       currentState = IDLE;
     break;
   }
-  return outputMode;
+  return step;
+}
+
+/************ TASKS ***********/
+// Run one at a time by the scheduler in loop(), highest priority due task first
+
+// Handles one serial request, anything it changed is posted as events
+#ifdef TRACE
+uint32_t lastRequest = 0; // millis() at the end of the last serial request
+#endif
+
+void serialTask()
+{
+  handleSerial();
+#ifdef TRACE
+  lastRequest = millis();
+#endif
+}
+
+bool serialReady()
+{
+  // A request posts at most 2 events, hold it back until the render task made room
+  return Rx.available() > 0 && events.space() >= 2;
+}
+
+// Brightness knob and buttons, posted as events
+void inputTask()
+{
+  static int8_t step = 0; // Press still waiting for room in the queue
+  PROFILE_BEGIN(ANALOG);
+  LEDscale = analogRead(POT_PIN) / 4;
+  PROFILE_END(ANALOG);
+  if (abs(LEDscale - prevLEDScale) > POT_THRES && events.push(Events::event{Events::BRIGHTNESS, (uint8_t)LEDscale}))
+    prevLEDScale = LEDscale;
+  if (!step)
+    step = buttonFSM();
+  if (step && events.push(Events::event{step > 0 ? Events::MODE_NEXT : Events::MODE_PREV, 0}))
+    step = 0;
+}
+
+// Loads the selected slot into the driver
+void storageTask()
+{
+  PROFILE_BEGIN(EEPROM_LOAD);
+  EEPROM_Load(currentMode);
+  PROFILE_END(EEPROM_LOAD);
+  playAnimation();
+  loadPending = false;
+}
+
+bool storageReady()
+{
+  return loadPending;
+}
+
+// Applies everything posted since the last frame, in order
+void handleEvents()
+{
+  const uint8_t modes = sizeof(defaults) / sizeof(AnimationDriver::animation);
+  if (events.empty())
+    return;
+  Events::event e;
+  while (events.pop(e))
+  {
+    switch (e.type)
+    {
+    case Events::MODE_NEXT:
+    case Events::MODE_PREV:
+    {
+      uint8_t mode = (currentMode + (e.type == Events::MODE_NEXT ? 1 : modes - 1)) % modes;
+      TRACE_EVENT(MODE_CHANGE, mode, currentMode, 0);
+      currentMode = mode;
+      settings.slot = mode;
+      settingsChanged = millis();
+      // Picking a mode ends a preview
+      previewActive = false;
+      loadPending = true;
+      break;
+    }
+    case Events::BRIGHTNESS:
+      strip.setBrightness(e.value);
+      settings.brightness = e.value;
+      settingsChanged = millis();
+      break;
+    case Events::SLOT_UPDATED:
+      // Reload when the playing slot changed underneath, a preview keeps playing
+      if (!previewActive && (e.value == currentMode || e.value == ALL_SLOTS))
+        loadPending = true;
+      // A restored image brings its own settings record, it becomes the live settings if it is valid
+      if (e.value == ALL_SLOTS)
+      {
+        if (EEPROM_LoadSettings())
+        {
+          if (settings.slot != currentMode)
+          {
+            TRACE_EVENT(MODE_CHANGE, settings.slot, currentMode, 0);
+            currentMode = settings.slot;
+            if (!previewActive)
+              loadPending = true;
+          }
+          strip.setBrightness(settings.brightness);
+          // The knob takes over again once it is turned
+          prevLEDScale = LEDscale;
+        }
+        else
+        {
+          // Nothing usable in the image, the live settings get written over it
+          settingsChanged = millis();
+        }
+      }
+      break;
+    case Events::PREVIEW:
+      if (e.value == PREVIEW_END)
+      {
+        // currentAnim no longer holds the preview, back to the selected slot
+        loadPending = true;
+      }
+      else
+      {
+        // currentAnim holds the preview until the next serial request, which only runs after this
+        playAnimation();
+        previewActive = true;
+        previewSlot = e.value;
+        loadPending = false;
+      }
+      break;
+    }
+  }
+  // Mode, brightness or preview may have changed
+  saveSnapshot();
+}
+
+// Pass current animation, time stamp, brightness, into animation driving function
+void renderTask()
+{
+  handleEvents();
+#ifdef EN_ANIMATION
+#ifdef RENDER_TIMER
+  // Rendered at a fixed rate by the timer, just hand the latest frame to the strip
+  showFrame();
+#else
+  PROFILE_INTERVAL(FRAME);
+  PROFILE_BEGIN(RUN);
+  animator.run(showColor);
+  PROFILE_END(RUN);
+#endif
+#endif
+  RENDER_HOLD();
+  savePhase(animator.phase());
+  RENDER_RELEASE();
+}
+
+// Writes settings once they stopped changing, so turning the knob costs one write instead of one per step
+void settingsTask()
+{
+  EEPROM_SaveSettings();
+}
+
+bool settingsReady()
+{
+  return millis() - settingsChanged >= SETTINGS_DELAY && memcmp(&settings, &savedSettings, offsetof(settingsRecord, crc)) != 0;
+}
+
+bool renderReady()
+{
+#ifdef RENDER_TIMER
+  if (frameSeq != shownSeq)
+    return true;
+#endif
+  // Events are applied before anything else runs
+  return !events.empty();
+}
+
+#ifdef TRACE
+// Only runs between serial requests, so records never interleave with a reply
+void traceTask()
+{
+  Tracer::drain();
 }
 
+// Host tools send their next request right after a reply, records are held back until the exchange is over
+bool traceReady()
+{
+  return Tracer::pending() && Rx.available() == 0 && millis() - lastRequest > TRACE_QUIET;
+}
+#endif
+
 void setup()
 {
   // Start Serial Communication
   Serial.begin(115200);
+  Rx.begin();
   Serial.println(F("ready"));
   // LED Setup
   strip.begin();
+  strip.setMaxRate(MAX_SHOW_RATE);
   strip.show();
   // Initial Brightness
   LEDscale = analogRead(POT_PIN);
   strip.setBrightness(LEDscale / 4);
+  settings.brightness = LEDscale / 4;
 
 #ifdef XIAO
   EEPROM.init();
@@ -459,18 +1091,74 @@ void setup()
 #ifdef WRITE_EEPROM
   EEPROM_WriteDefaults();
 #endif
-  // Animation Controller
-  EEPROM_Load(0);
-  animator.updateAnimation(currentAnim);
+  if (snapshotValid())
+  {
+    // Soft reset, carry on where playback stopped, the settings record isn't needed
+    currentMode = snapshot.slot;
+    settings.slot = snapshot.slot;
+    settings.brightness = snapshot.brightness;
+    strip.setBrightness(snapshot.brightness);
+    prevLEDScale = LEDscale / 4;
+    // savedSettings survived along with the snapshot, storage only has to be asked if it didn't
+    if (savedSettings.crc != settingsCrc(savedSettings))
+      EEPROM_Read(SETTINGS_ADDR, (uint8_t *)&savedSettings, sizeof(savedSettings));
+    // A preview is still in currentAnim, anything else comes back from its slot
+    previewActive = snapshot.preview != PREVIEW_END && snapshot.animCrc == animCrc() && currentAnim.frameCount <= MAX_FRAMES;
+    previewSlot = snapshot.preview;
+    if (!previewActive)
+      EEPROM_Load(currentMode);
+    uint32_t phase = snapshot.phase;
+    playAnimation();
+    animator.seek(phase);
+    savePhase(phase);
+  }
+  else
+  {
+    // Resume the mode and brightness of the last session
+    if (EEPROM_LoadSettings())
+    {
+      currentMode = settings.slot;
+      strip.setBrightness(settings.brightness);
+      // The knob takes over again once it is turned
+      prevLEDScale = LEDscale / 4;
+    }
+    // Animation Controller
+    EEPROM_Load(currentMode);
+    playAnimation();
+  }
+#ifdef RENDER_TIMER
+  RenderTimer::begin(RENDER_RATE, renderTick);
+#endif
   // Initialize timers
   btnTimer = millis();
+  // Tasks, in LAMP_TASKS order (Tasks.h) so the 't' intent reports them under the right names
+  static_assert(LAMP_TASK_COUNT <= MAX_TASKS, "LAMP_TASKS lists more tasks than the table holds");
+  bool added = Scheduler::add(serialTask, 0, 1, serialReady);
+  added &= Scheduler::add(inputTask, INPUT_PERIOD, 0);
+  added &= Scheduler::add(storageTask, 0, 2, storageReady);
+#ifdef RENDER_TIMER
+  added &= Scheduler::add(renderTask, 0, 3, renderReady);
+#else
+  added &= Scheduler::add(renderTask, RENDER_PERIOD, 3, renderReady);
+#endif
+  added &= Scheduler::add(settingsTask, 0, 0, settingsReady);
+#ifdef TRACE
+  added &= Scheduler::add(traceTask, 0, 0, traceReady);
+#endif
+  // A task that didn't fit would silently never run, stop here instead
+  while (!added)
+  {
+    Serial.println(F("Task table full, raise MAX_TASKS"));
+    delay(1000);
+  }
+  Scheduler::reset();
   // Button Setup
 
   pinMode(BTN_DWN_PIN, INPUT_PULLUP);
   pinMode(BTN_UP_PIN, INPUT_PULLUP);
 
 #ifdef DEBUG_EEPROM_SERIAL
-  for (uint8_t i = 0; i < 6; i++)
+  for (uint8_t i = 0; i < ANIM_SLOTS; i++)
   {
     Serial.println(F("------------------------"));
     EEPROM_Dump_Anim(i);
@@ -482,48 +1170,8 @@ void setup()
 
 void loop()
 {
-
-  static uint16_t lastMode = 0;
-  uint16_t currentMode = 0;
-  if (Serial.available() > 0)
-  {
-    // Handle Serial Request
-    handleSerial();
-    EEPROM_Load(currentMode);
-    animator.updateAnimation(currentAnim);
-  }
-  else
-  {
-    /************ BRIGHTNESS KNOB ***********/
-    LEDscale = analogRead(POT_PIN) / 4;
-    if (abs(LEDscale - prevLEDScale) > POT_THRES)
-    {
-      
-      strip.setBrightness(LEDscale);
-      prevLEDScale = LEDscale;
-    }
-    currentMode = buttonFSM();
-    // Only trigger updates on changes
-    if (currentMode != lastMode)
-    {
-      EEPROM_Load(currentMode);
-      animator.updateAnimation(currentAnim);
-      lastMode = currentMode;
-    }
-
-    /************ DRIVING LEDS ***********/
-    // Pass current animation, time stamp, brightness, into animation driving function
-#ifdef EN_ANIMATION
-    animator.run([](uint8_t r, uint8_t g, uint8_t b)
-                 {
-                   #ifdef SKIP_PIXEL
-                   strip.fill(strip.Color(r, g, b),1,0); // Fill strip, skipping first pixel
-                   #else
-                   strip.fill(strip.Color(r, g, b)); // Fill entire strip
-                   #endif
-                   strip.show(); });
-#endif
-  }
+  PROFILE_BEGIN(LOOP);
+  Scheduler::run();
 
   /************ DUBUGGING HELP ***********/
 
@@ -531,4 +1179,5 @@ void loop()
   Serial.println();
   Serial.flush();
 #endif
+  PROFILE_END(LOOP);
 }
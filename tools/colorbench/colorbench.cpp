@@ -0,0 +1,122 @@
+/**
+ * LocalMoodLamp/tools/colorbench
+ *
+ * Host benchmark of the packed (SWAR) color kernels in ColorMath.h against per-channel loops:
+ * the original float interpolation, the same math in integers, and brightness scaling.
+ * Also reports the largest per-channel difference from the float version.
+ *
+ * Usage:
+ *  colorbench [N]   N interpolations per kernel (default 10000000)
+ *
+ * On the lamp itself, compare the `run` section of a -D PROFILE build (lampctl stats) before and after.
+ */
+
+#include <AnimationDriver.h>
+#include <ColorMath.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+struct sample
+{
+    AnimationDriver::animFrame last, next;
+    uint32_t time;
+};
+
+// Original per-channel float interpolation
+static void floatLoop(const sample &s, uint8_t color[3])
+{
+    for (uint8_t i = 0; i < 3; i++)
+        color[i] = (uint8_t)((float)s.last.color[i] + ((float)s.next.color[i] - (float)s.last.color[i]) / ((float)s.next.time - (float)s.last.time) * (float)(s.time - s.last.time));
+}
+
+// Same 0..256 weight as the packed kernel, one channel at a time
+static void intLoop(const sample &s, uint8_t color[3])
+{
+    uint16_t w = ColorMath::weight(s.time - s.last.time, s.next.time - s.last.time);
+    for (uint8_t i = 0; i < 3; i++)
+        color[i] = (s.last.color[i] * (256 - w) + s.next.color[i] * w) >> 8;
+}
+
+// Body of AnimationDriver::interpolate(), inlined here like the other kernels
+static void packed(const sample &s, uint8_t color[3])
+{
+    uint16_t w = ColorMath::weight(s.time - s.last.time, s.next.time - s.last.time);
+    ColorMath::packed from = ColorMath::pack(s.last.color[0], s.last.color[1], s.last.color[2]);
+    ColorMath::packed to = ColorMath::pack(s.next.color[0], s.next.color[1], s.next.color[2]);
+    ColorMath::unpack(ColorMath::lerp(from, to, w), color);
+}
+
+static void scaleLoop(const sample &s, uint8_t color[3])
+{
+    for (uint8_t i = 0; i < 3; i++)
+        color[i] = (s.last.color[i] * (s.time & 0xFF)) >> 8;
+}
+
+static void scalePacked(const sample &s, uint8_t color[3])
+{
+    ColorMath::unpack(ColorMath::scale(ColorMath::pack(s.last.color[0], s.last.color[1], s.last.color[2]), s.time & 0xFF), color);
+}
+
+// Time one kernel over the whole sample set, the checksum keeps the compiler from dropping the work
+static double timeKernel(void (*kernel)(const sample &, uint8_t *), const std::vector<sample> &samples, uint32_t &checksum)
+{
+    uint8_t color[3];
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        kernel(samples[i], color);
+        checksum += color[0] + color[1] + color[2];
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 0) : 10000000;
+    std::vector<sample> samples(count);
+    uint32_t state = 0xC0102u;
+    for (size_t i = 0; i < count; i++)
+    {
+        sample &s = samples[i];
+        for (uint8_t c = 0; c < 3; c++)
+        {
+            state = state * 1664525u + 1013904223u;
+            s.last.color[c] = state >> 24;
+            s.next.color[c] = state >> 16;
+        }
+        state = state * 1664525u + 1013904223u;
+        s.last.time = state >> 20;
+        s.next.time = s.last.time + 1 + (state & 0xFFFF);
+        s.time = s.last.time + state % (s.next.time - s.last.time + 1);
+    }
+
+    // Accuracy against the float version
+    unsigned worst = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t a[3], b[3];
+        floatLoop(samples[i], a);
+        packed(samples[i], b);
+        for (uint8_t c = 0; c < 3; c++)
+            if ((unsigned)abs(a[c] - b[c]) > worst)
+                worst = abs(a[c] - b[c]);
+    }
+
+    struct
+    {
+        const char *name;
+        void (*kernel)(const sample &, uint8_t *);
+    } kernels[] = {{"lerp float loop", floatLoop}, {"lerp int loop", intLoop}, {"lerp packed", packed}, {"scale loop", scaleLoop}, {"scale packed", scalePacked}};
+
+    uint32_t checksum = 0;
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(*kernels); k++)
+    {
+        double seconds = timeKernel(kernels[k].kernel, samples, checksum);
+        printf("%-16s %8.2f ns/op\n", kernels[k].name, seconds / count * 1e9);
+    }
+    printf("packed lerp is within %u of the float loop per channel (checksum %08x)\n", worst, checksum);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "AnimationIO.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace AnimationIO
+{
+    void encode(const slot &s, std::vector<uint8_t> &out)
+    {
+        out.push_back(s.index);
+        out.push_back(s.anim.frameCount);
+        for (uint8_t i = 0; i < s.anim.frameCount; i++)
+        {
+            const AnimationDriver::animFrame &f = s.anim.frames[i];
+            out.push_back(f.color[0]);
+            out.push_back(f.color[1]);
+            out.push_back(f.color[2]);
+            out.push_back((uint8_t)(f.time >> 24));
+            out.push_back((uint8_t)(f.time >> 16));
+            out.push_back((uint8_t)(f.time >> 8));
+            out.push_back((uint8_t)f.time);
+        }
+    }
+
+    bool decode(const std::vector<uint8_t> &data, size_t &pos, slot &s)
+    {
+        if (pos + META_BYTES > data.size())
+            return false;
+        uint8_t count = data[pos + 1];
+        if (count > MAX_FRAMES || pos + META_BYTES + count * FRAME_BYTES > data.size())
+            return false;
+        memset(&s, 0, sizeof(s));
+        s.index = data[pos];
+        s.anim.frameCount = count;
+        const uint8_t *p = &data[pos + META_BYTES];
+        for (uint8_t i = 0; i < count; i++, p += FRAME_BYTES)
+        {
+            AnimationDriver::animFrame &f = s.anim.frames[i];
+            f.color[0] = p[0];
+            f.color[1] = p[1];
+            f.color[2] = p[2];
+            f.time = (uint32_t)p[3] << 24 | (uint32_t)p[4] << 16 | (uint32_t)p[5] << 8 | (uint32_t)p[6];
+        }
+        // Same rule the lamp uses, total time is the last frame's timestamp
+        if (count)
+            s.anim.time = s.anim.frames[count - 1].time;
+        pos += META_BYTES + count * FRAME_BYTES;
+        return true;
+    }
+
+    bool readDump(const std::string &path, std::vector<slot> &out)
+    {
+        FILE *f = fopen(path.c_str(), "rb");
+        if (!f)
+            return false;
+        std::vector<uint8_t> data;
+        uint8_t chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+            data.insert(data.end(), chunk, chunk + n);
+        fclose(f);
+
+        size_t pos = 0;
+        while (pos < data.size())
+        {
+            slot s;
+            if (!decode(data, pos, s))
+                return false;
+            out.push_back(s);
+        }
+        return true;
+    }
+
+    bool writeDump(const std::string &path, const std::vector<slot> &slots)
+    {
+        std::vector<uint8_t> data;
+        for (size_t i = 0; i < slots.size(); i++)
+            encode(slots[i], data);
+        FILE *f = fopen(path.c_str(), "wb");
+        if (!f)
+            return false;
+        bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+        return fclose(f) == 0 && ok;
+    }
+
+} // namespace AnimationIO
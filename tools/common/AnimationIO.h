@@ -0,0 +1,33 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#ifndef ANIMATION
+#include <AnimationDriver.h>
+#endif
+#define ANIMATION_IO // Used to stop duplicate imports
+
+// Host-side helpers for the serial wire format of an animation slot:
+// slot index, frame count, then per frame R, G, B and a big endian 32 bit timestamp.
+// A slot dump file is any number of these records back to back.
+namespace AnimationIO
+{
+    const size_t FRAME_BYTES = 7;
+    const size_t META_BYTES = 2;
+
+    // An animation along with the slot it belongs to
+    struct slot
+    {
+        uint8_t index;
+        AnimationDriver::animation anim;
+    };
+
+    // Append the wire encoding of a slot to out
+    void encode(const slot &, std::vector<uint8_t> &out);
+    // Decode one slot starting at data[pos], advancing pos. Returns false on truncated or oversized records
+    bool decode(const std::vector<uint8_t> &data, size_t &pos, slot &);
+
+    bool readDump(const std::string &path, std::vector<slot> &out);
+    bool writeDump(const std::string &path, const std::vector<slot> &slots);
+
+} // namespace AnimationIO
@@ -0,0 +1,51 @@
+#include "Timeline.h"
+
+namespace Timeline
+{
+    // Virtual clock and output sink, per thread since the driver only takes plain function pointers
+    static thread_local unsigned long virtualTime;
+    static thread_local std::vector<rgb> *sink;
+
+    static unsigned long virtualClock()
+    {
+        return virtualTime;
+    }
+
+    static void capture(uint8_t r, uint8_t g, uint8_t b)
+    {
+        sink->push_back(rgb{r, g, b});
+    }
+
+    void renderRange(const AnimationDriver::animation &anim, uint32_t start, uint32_t count, rgb *out)
+    {
+        uint8_t hint = 0;
+        uint8_t color[3];
+        for (uint32_t i = 0; i < count; i++)
+        {
+            AnimationDriver::evaluate(anim, start + i, color, &hint);
+            out[i] = rgb{color[0], color[1], color[2]};
+        }
+    }
+
+    void render(const AnimationDriver::animation &anim, uint32_t durationMs, std::vector<rgb> &out)
+    {
+        out.resize(durationMs);
+        renderRange(anim, 0, durationMs, out.data());
+    }
+
+    void renderAt(const AnimationDriver::animation &anim, const std::vector<uint32_t> &ticks, std::vector<rgb> &out)
+    {
+        out.clear();
+        out.reserve(ticks.size());
+        sink = &out;
+        virtualTime = 0;
+        AnimationDriver::AnimationDriver driver(anim, virtualClock);
+        for (size_t i = 0; i < ticks.size(); i++)
+        {
+            virtualTime = ticks[i];
+            driver.run(capture);
+        }
+        sink = nullptr;
+    }
+
+} // namespace Timeline
@@ -0,0 +1,40 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#ifndef ANIMATION
+#include <AnimationDriver.h>
+#endif
+#define TIMELINE // Used to stop duplicate imports
+
+// Renders animations on the host, through AnimationDriver::evaluate() or the real driver on a virtual clock
+namespace Timeline
+{
+    struct rgb
+    {
+        uint8_t r, g, b;
+        bool operator==(const rgb &o) const { return r == o.r && g == o.g && b == o.b; }
+    };
+
+    /**
+     * Samples evaluate() once per millisecond from t = start
+     * @param out receives count colors
+     * Stateless, so ranges of the same timeline can be rendered on different threads
+     */
+    void renderRange(const AnimationDriver::animation &anim, uint32_t start, uint32_t count, rgb *out);
+
+    /**
+     * Plays an animation from t = 0 and samples it once per millisecond
+     * @param anim animation to play
+     * @param durationMs number of samples to take
+     * @param out receives one color per millisecond (resized first)
+     */
+    void render(const AnimationDriver::animation &anim, uint32_t durationMs, std::vector<rgb> &out);
+
+    /**
+     * Runs the stateful driver itself at arbitrary increasing clock values
+     * @param ticks system times (ms) to call run() at, the animation starts at t = 0
+     * Safe to call from several threads at once, each thread has its own clock
+     */
+    void renderAt(const AnimationDriver::animation &anim, const std::vector<uint32_t> &ticks, std::vector<rgb> &out);
+
+} // namespace Timeline
@@ -0,0 +1,160 @@
+// In-memory Arduino core for the fuzz harness: Serial reads from the fuzz input, time is virtual
+#include "FuzzCore.h"
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Adafruit_NeoPixel.h>
+#include <limits.h>
+#include <stdio.h>
+
+SimSerial Serial;
+EEPROMClass EEPROM;
+size_t simRxBufferSize = INT_MAX; // The fuzz input is all there at once and nothing is ever dropped
+
+namespace FuzzCore
+{
+    const uint8_t *input = nullptr;
+    size_t inputSize = 0;
+    size_t inputPos = 0;
+    size_t outputBytes = 0;
+    unsigned long clock = 0;
+    unsigned long idlePolls = 0;
+    uint8_t eeprom[SIM_EEPROM_SIZE];
+
+    void feed(const uint8_t *data, size_t size)
+    {
+        input = data;
+        inputSize = size;
+        inputPos = 0;
+        idlePolls = 0;
+    }
+
+    size_t remaining()
+    {
+        return inputSize - inputPos;
+    }
+} // namespace FuzzCore
+
+using namespace FuzzCore;
+
+void resetFunc()
+{
+    throw FuzzCore::reset();
+}
+
+// Every time query moves the clock so timeouts expire without real waiting
+unsigned long millis()
+{
+    return ++clock;
+}
+
+unsigned long micros()
+{
+    return clock * 1000;
+}
+
+void delay(unsigned long ms)
+{
+    clock += ms;
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+int digitalRead(uint8_t)
+{
+    return HIGH;
+}
+
+int analogRead(uint8_t)
+{
+    return 512;
+}
+
+int SimSerial::available()
+{
+    // A request that keeps polling an empty port without ever timing out would hang a real lamp
+    if (!remaining() && ++idlePolls > 1000000UL)
+    {
+        fprintf(stderr, "fuzz: serial handler spins forever on an empty port\n");
+        abort();
+    }
+    return remaining();
+}
+
+int SimSerial::availableForWrite()
+{
+    return 64;
+}
+
+int SimSerial::peek()
+{
+    return remaining() ? input[inputPos] : -1;
+}
+
+int SimSerial::read()
+{
+    return remaining() ? input[inputPos++] : -1;
+}
+
+int SimSerial::timedRead()
+{
+    int c = read();
+    if (c < 0)
+        clock += timeout;
+    return c;
+}
+
+size_t SimSerial::readBytes(uint8_t *buf, size_t len)
+{
+    size_t count = 0;
+    while (count < len)
+    {
+        int c = timedRead();
+        if (c < 0)
+            break;
+        buf[count++] = c;
+    }
+    return count;
+}
+
+size_t SimSerial::write(uint8_t)
+{
+    outputBytes++;
+    return 1;
+}
+
+size_t SimSerial::write(const uint8_t *, size_t len)
+{
+    outputBytes += len;
+    return len;
+}
+
+void SimSerial::flush() {}
+
+// Out of range EEPROM access is a bug worth stopping on, the real part would silently wrap
+uint8_t EEPROMClass::read(int idx)
+{
+    if (idx < 0 || idx >= SIM_EEPROM_SIZE)
+    {
+        fprintf(stderr, "fuzz: EEPROM read at %d\n", idx);
+        abort();
+    }
+    return eeprom[idx];
+}
+
+void EEPROMClass::write(int idx, uint8_t val)
+{
+    if (idx < 0 || idx >= SIM_EEPROM_SIZE)
+    {
+        fprintf(stderr, "fuzz: EEPROM write at %d\n", idx);
+        abort();
+    }
+    eeprom[idx] = val;
+}
+
+void EEPROMClass::update(int idx, uint8_t val)
+{
+    if (read(idx) != val)
+        write(idx, val);
+}
+
+void Adafruit_NeoPixel::show() {}
@@ -0,0 +1,19 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <EEPROM.h>
+#define FUZZ_CORE // Used to stop duplicate imports
+
+// State of the in-memory Arduino core the fuzz harness runs main.cpp on
+namespace FuzzCore
+{
+    // Thrown by resetFunc(), the lamp's response to a failed transfer
+    struct reset
+    {
+    };
+
+    void feed(const uint8_t *data, size_t size); // Make data the bytes Serial will receive
+    size_t remaining();                          // Bytes not consumed yet
+
+    extern size_t outputBytes;
+    extern uint8_t eeprom[SIM_EEPROM_SIZE];
+} // namespace FuzzCore
@@ -0,0 +1,193 @@
+/**
+ * LocalMoodLamp/tools/fuzz
+ *
+ * Fuzz harness for the serial protocol: feeds arbitrary byte streams through loop() -> handleSerial()
+ * on an in-memory Arduino core, with virtual time so every timeout expires instantly.
+ * Memory errors are caught by the sanitizers, out of range EEPROM access and handlers that spin forever abort.
+ *
+ * libFuzzer (clang), compiling every .cpp in src and tools/fuzz:
+ *  clang++ -g -O1 -std=gnu++17 -fsanitize=fuzzer,address,undefined -D LIBFUZZER -D NANO -D SIM -D NUM_LEDS=1
+ *      -I include -I tools/sim/include SOURCES -o fuzz_serial && ./fuzz_serial corpus/
+ *
+ * Standalone (pio run -e fuzz), no libFuzzer needed:
+ *  program input...              Replay files, e.g. crashes found by libFuzzer
+ *  program --random N [--seed S] Run N generated streams (valid requests with mutations and noise)
+ * Both report parse throughput.
+ */
+
+#include <Arduino.h>
+#include <AnimationDriver.h>
+#include <DefaultAnimations.h>
+#include <EventQueue.h>
+#include <SerialRx.h>
+#include "FuzzCore.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+void setup();
+void loop();
+extern EventQueue<Events::event, EVENT_QUEUE_SIZE> events;
+
+extern "C" int LLVMFuzzerInitialize(int *, char ***)
+{
+    // Start from the factory image so downloads have something to send
+    memset(FuzzCore::eeprom, 0xFF, sizeof(FuzzCore::eeprom));
+    memcpy(FuzzCore::eeprom, defaults, sizeof(defaults));
+    setup();
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    // Every input starts like the lamp after a reset, nothing received and nothing queued
+    FuzzCore::feed(nullptr, 0);
+    while (Rx.read() >= 0)
+        ;
+    Events::event e;
+    while (events.pop(e))
+        ;
+    FuzzCore::feed(data, size);
+    try
+    {
+        // Same path as the lamp: every loop() with pending bytes handles one request, until the Rx ring is empty too.
+        // Each pass takes at least one byte or makes room for the next request, more passes than that is a hang
+        size_t passes = 2 * size + 16;
+        while (FuzzCore::remaining() || Rx.available())
+        {
+            if (!passes--)
+            {
+                fprintf(stderr, "fuzz: input not consumed, requests stopped making progress\n");
+                abort();
+            }
+            loop();
+        }
+    }
+    catch (FuzzCore::reset &)
+    {
+        // Resetting is the protocol's answer to a failed transfer, not a fault
+    }
+    return 0;
+}
+
+#ifndef LIBFUZZER
+static uint32_t rngState = 0xF022u;
+static uint32_t rng()
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+// A request stream that is mostly well formed, then damaged a little
+static void generate(std::vector<uint8_t> &out)
+{
+    out.clear();
+    uint8_t requests = 1 + rng() % 4;
+    for (uint8_t r = 0; r < requests; r++)
+    {
+        switch (rng() % 4)
+        {
+        case 0:
+        {
+            // Upload or preview, frame count anywhere in 0..255
+            uint8_t slot = rng() % 8;
+            uint8_t frames = rng() % 4 ? rng() % 21 : rng();
+            out.push_back(rng() % 4 ? '0' + slot % 6 : 'p');
+            out.push_back('-');
+            out.push_back(slot);
+            out.push_back(frames);
+            size_t body = rng() % 4 ? frames * 7 : rng() % 300;
+            for (size_t i = 0; i < body; i++)
+                out.push_back(rng());
+            out.push_back(rng() % 4 ? 0xFF : rng());
+            break;
+        }
+        case 1:
+            // Download with mostly good acknowledges
+            out.push_back('d');
+            out.push_back('-');
+            for (uint8_t i = 0; i < 18; i++)
+                out.push_back(rng() % 16 ? 0xFF : rng());
+            break;
+        case 2:
+        {
+            // Commit, image read/restore, task or receive stats, or an unknown intent
+            static const char intents[] = {'c', 'r', 'w', 't', 'b'};
+            char intent = rng() % 4 ? intents[rng() % sizeof(intents)] : rng();
+            out.push_back(intent);
+            out.push_back('-');
+            if (intent == 'w')
+            {
+                // Mostly the right size, then a partial or whole image and a CRC
+                uint16_t size = rng() % 4 ? SIM_EEPROM_SIZE : rng();
+                out.push_back(size >> 8);
+                out.push_back(size);
+                for (size_t i = rng() % (SIM_EEPROM_SIZE + 3); i; i--)
+                    out.push_back(rng());
+            }
+            break;
+        }
+        default:
+            // Noise
+            for (uint8_t i = rng() % 32; i; i--)
+                out.push_back(rng());
+            break;
+        }
+    }
+    // Mutations
+    for (uint8_t m = rng() % 3; m && !out.empty(); m--)
+        out[rng() % out.size()] = rng();
+    if (rng() % 4 == 0 && !out.empty())
+        out.resize(rng() % out.size());
+}
+
+int main(int argc, char **argv)
+{
+    LLVMFuzzerInitialize(&argc, &argv);
+    size_t runs = 0, bytes = 0;
+    std::vector<uint8_t> data;
+    auto start = std::chrono::steady_clock::now();
+
+    if (argc >= 3 && strcmp(argv[1], "--random") == 0)
+    {
+        unsigned long count = strtoul(argv[2], nullptr, 0);
+        if (argc >= 5 && strcmp(argv[3], "--seed") == 0)
+            rngState = strtoul(argv[4], nullptr, 0) | 1;
+        for (unsigned long i = 0; i < count; i++)
+        {
+            generate(data);
+            LLVMFuzzerTestOneInput(data.data(), data.size());
+            runs++;
+            bytes += data.size();
+        }
+    }
+    else
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            FILE *f = fopen(argv[i], "rb");
+            if (!f)
+            {
+                fprintf(stderr, "fuzz: could not read %s\n", argv[i]);
+                return 1;
+            }
+            data.clear();
+            int c;
+            while ((c = fgetc(f)) != EOF)
+                data.push_back(c);
+            fclose(f);
+            LLVMFuzzerTestOneInput(data.data(), data.size());
+            runs++;
+            bytes += data.size();
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("fuzz: %zu inputs, %zu bytes in %.3f s: %.0f inputs/s, %.2f MB/s parsed, %zu bytes answered\n",
+           runs, bytes, seconds, runs / seconds, bytes / seconds / 1e6, FuzzCore::outputBytes);
+    return 0;
+}
+#endif
@@ -0,0 +1,344 @@
+/**
+ * LocalMoodLamp/tools/golden
+ *
+ * Golden trace check for AnimationDriver output.
+ * Plays every defaults[] entry plus seeded random animations through the driver with a deterministic
+ * clock and records the exact RGB sequence handed to the driving function.
+ *
+ * Usage:
+ *  golden --write golden.txt               Record fingerprints of the current output
+ *  golden --check golden.txt [-t N]         Compare against recorded fingerprints
+ *  [--fuzz N] [--seed S]                    Number of random animations (default 64) and PRNG seed,
+ *                                          16 more are played with ticks that skip frames and periods
+ *
+ * On a fingerprint mismatch every sample is compared against a frozen copy of the original
+ * float implementation, and the check passes if no channel is off by more than the tolerance (-t, default 0).
+ * Every trace is also sampled through the stateless AnimationDriver::evaluate(), which has to match the driver exactly.
+ *
+ * Built with -D RENDER_CACHE, animations the driver caches are compared against evaluate() and the reference at the
+ * start of each cache step. The fingerprints are recorded without the cache, so run that build with -t 1.
+ */
+
+#include <AnimationDriver.h>
+#include <DefaultAnimations.h>
+#include "../common/AnimationIO.h"
+#include "../common/Timeline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+struct testCase
+{
+    std::string name;
+    AnimationDriver::animation anim;
+    std::vector<uint32_t> ticks; // Clock values run() is called at
+};
+
+// Small deterministic PRNG (xorshift32) so the corpus is identical on every host
+static uint32_t rngState;
+static uint32_t rng()
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+static uint32_t rngRange(uint32_t lo, uint32_t hi)
+{
+    return lo + rng() % (hi - lo + 1);
+}
+
+/**
+ * Frozen copy of the original updateTime()/interpolateColor() float math, used as the reference when
+ * the driver's output is allowed to deviate within a tolerance. The original stepped one frame per run(), the loop
+ * keeps stepping so ticks further apart than a frame gap or a whole period are caught up like the driver does
+ * @param step samples at whole multiples of step ms into the period, as the render cache plays back
+ */
+static void reference(const AnimationDriver::animation &a, const std::vector<uint32_t> &ticks, std::vector<Timeline::rgb> &out, uint32_t step = 1)
+{
+    unsigned long lastStartTime = 0;
+    uint8_t frameIndex = 0;
+    out.clear();
+    for (size_t i = 0; i < ticks.size(); i++)
+    {
+        unsigned long currentTime = ticks[i] - lastStartTime;
+        while (currentTime > a.frames[frameIndex + 1].time)
+        {
+            frameIndex++;
+            if (frameIndex == a.frameCount - 1)
+            {
+                lastStartTime += a.time;
+                currentTime -= a.time;
+                frameIndex = 0;
+            }
+        }
+        unsigned long at = currentTime / step * step;
+        uint8_t segment = frameIndex;
+        while (segment && at < a.frames[segment].time)
+            segment--;
+        const AnimationDriver::animFrame *last = &a.frames[segment];
+        const AnimationDriver::animFrame *next = &a.frames[segment + 1];
+        uint8_t c[3];
+        for (uint8_t ch = 0; ch < 3; ch++)
+            c[ch] = (uint8_t)((float)last->color[ch] + ((float)next->color[ch] - (float)last->color[ch]) / ((float)next->time - (float)last->time) * (float)(at - last->time));
+        out.push_back(Timeline::rgb{c[0], c[1], c[2]});
+    }
+}
+
+#ifdef RENDER_CACHE
+static unsigned long startClock()
+{
+    return 0;
+}
+
+// Whether the driver plays this animation from its cache
+static bool cached(const AnimationDriver::animation &a)
+{
+    static AnimationDriver::AnimationDriver driver(startClock);
+    driver.updateAnimation(a);
+    return driver.cached();
+}
+
+// Time into the animation the cache shows at t: wrapped into the period like evaluate(), then down to a whole step
+static uint32_t cachedTime(const AnimationDriver::animation &a, uint32_t t)
+{
+    if (a.time && t > a.time)
+        t = (t - 1) % a.time + 1;
+    return t / RENDER_CACHE_STEP * RENDER_CACHE_STEP;
+}
+#endif
+
+static uint32_t fingerprint(const std::vector<Timeline::rgb> &samples)
+{
+    // FNV-1a over the raw RGB stream
+    uint32_t h = 2166136261UL;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        const uint8_t bytes[3] = {samples[i].r, samples[i].g, samples[i].b};
+        for (uint8_t b = 0; b < 3; b++)
+            h = (h ^ bytes[b]) * 16777619UL;
+    }
+    return h;
+}
+
+// Default animations at a steady 1 ms tick for two and a half periods, so wraparound is covered
+static void addDefaults(std::vector<testCase> &cases)
+{
+    for (size_t d = 0; d < sizeof(defaults) / sizeof(AnimationDriver::animation); d++)
+    {
+        testCase c{"default" + std::to_string(d), defaults[d], {}};
+        uint32_t span = c.anim.time;
+        if (c.anim.frames[c.anim.frameCount - 1].time > span)
+            span = c.anim.frames[c.anim.frameCount - 1].time;
+        for (uint32_t t = 0; t < span * 5 / 2; t++)
+            c.ticks.push_back(t);
+        cases.push_back(c);
+    }
+}
+
+// Random but well formed animation: first frame at 0, increasing times, total time = last frame
+static void randomAnimation(AnimationDriver::animation &anim, uint32_t &minGap)
+{
+    memset(&anim, 0, sizeof(anim));
+    anim.frameCount = rngRange(2, MAX_FRAMES);
+    minGap = UINT32_MAX;
+    for (uint8_t f = 0; f < anim.frameCount; f++)
+    {
+        for (uint8_t ch = 0; ch < 3; ch++)
+            anim.frames[f].color[ch] = rng();
+        if (f)
+        {
+            uint32_t gap = rngRange(10, 2000);
+            if (gap < minGap)
+                minGap = gap;
+            anim.frames[f].time = anim.frames[f - 1].time + gap;
+        }
+    }
+    anim.time = anim.frames[anim.frameCount - 1].time;
+}
+
+// Random animations played with a jittery tick that never steps further than the shortest frame gap
+static void addFuzz(std::vector<testCase> &cases, uint32_t count)
+{
+    for (uint32_t n = 0; n < count; n++)
+    {
+        testCase c{"fuzz" + std::to_string(n), AnimationDriver::animation(), {}};
+        uint32_t minGap;
+        randomAnimation(c.anim, minGap);
+        uint32_t maxStep = minGap < 25 ? minGap : 25;
+        for (uint32_t t = 0; t < c.anim.time * 5 / 2; t += rngRange(1, maxStep))
+            c.ticks.push_back(t);
+        cases.push_back(c);
+    }
+}
+
+/**
+ * Random animations played with ticks that skip whole frames and periods, as when loop() stalls on a serial request,
+ * so the catch-up in updateTime() and the segment search in evaluate() are covered
+ */
+static void addLate(std::vector<testCase> &cases, uint32_t count)
+{
+    for (uint32_t n = 0; n < count; n++)
+    {
+        testCase c{"late" + std::to_string(n), AnimationDriver::animation(), {}};
+        uint32_t minGap;
+        randomAnimation(c.anim, minGap);
+        uint32_t t = 0;
+        for (uint32_t i = 0; i < 2000; i++)
+        {
+            c.ticks.push_back(t);
+            // Mostly past the next frame, now and then a few periods at once
+            t += rng() % 8 ? rngRange(minGap, c.anim.time) : rngRange(c.anim.time, c.anim.time * 3);
+        }
+        cases.push_back(c);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *writePath = nullptr;
+    const char *checkPath = nullptr;
+    unsigned tolerance = 0;
+    uint32_t fuzzCount = 64;
+    uint32_t lateCount = 16;
+    rngState = 0x1A3D5EEDUL;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--write") == 0)
+            writePath = argv[i + 1];
+        else if (strcmp(argv[i], "--check") == 0)
+            checkPath = argv[i + 1];
+        else if (strcmp(argv[i], "-t") == 0)
+            tolerance = strtoul(argv[i + 1], nullptr, 0);
+        else if (strcmp(argv[i], "--fuzz") == 0)
+            fuzzCount = strtoul(argv[i + 1], nullptr, 0);
+        else if (strcmp(argv[i], "--seed") == 0)
+            rngState = strtoul(argv[i + 1], nullptr, 0) | 1;
+    }
+    if (!writePath == !checkPath)
+    {
+        fprintf(stderr, "usage: golden (--write | --check) golden.txt [-t tolerance] [--fuzz N] [--seed S]\n");
+        return 2;
+    }
+
+    std::vector<testCase> cases;
+    addDefaults(cases);
+    addFuzz(cases, fuzzCount);
+    addLate(cases, lateCount);
+
+    if (writePath)
+    {
+        FILE *f = fopen(writePath, "w");
+        if (!f)
+        {
+            fprintf(stderr, "golden: could not write %s\n", writePath);
+            return 1;
+        }
+        std::vector<Timeline::rgb> samples;
+        for (size_t i = 0; i < cases.size(); i++)
+        {
+            Timeline::renderAt(cases[i].anim, cases[i].ticks, samples);
+            fprintf(f, "%s %zu %08x\n", cases[i].name.c_str(), samples.size(), fingerprint(samples));
+        }
+        fclose(f);
+        printf("golden: recorded %zu traces\n", cases.size());
+        return 0;
+    }
+
+    // Load recorded fingerprints
+    std::map<std::string, uint32_t> recorded;
+    FILE *f = fopen(checkPath, "r");
+    if (!f)
+    {
+        fprintf(stderr, "golden: could not read %s\n", checkPath);
+        return 1;
+    }
+    char name[64];
+    size_t count;
+    unsigned hash;
+    while (fscanf(f, "%63s %zu %x", name, &count, &hash) == 3)
+        recorded[name] = hash;
+    fclose(f);
+
+    unsigned failures = 0, approximate = 0;
+    std::vector<Timeline::rgb> samples, expected;
+    for (size_t i = 0; i < cases.size(); i++)
+    {
+        const testCase &c = cases[i];
+        Timeline::renderAt(c.anim, c.ticks, samples);
+        std::map<std::string, uint32_t>::iterator rec = recorded.find(c.name);
+        if (rec == recorded.end())
+        {
+            printf("MISSING %s (rerun with the same --fuzz/--seed it was recorded with)\n", c.name.c_str());
+            failures++;
+            continue;
+        }
+
+        // The driver plays through evaluate(), the same ticks sampled without any driver state must agree
+        // A cached animation shows the sample taken at the start of the cache step the tick falls in
+        uint32_t step = 1;
+#ifdef RENDER_CACHE
+        bool fromCache = cached(c.anim);
+        if (fromCache)
+            step = RENDER_CACHE_STEP;
+#endif
+        uint8_t color[3];
+        size_t s = 0;
+        for (; s < c.ticks.size(); s++)
+        {
+            uint32_t t = c.ticks[s];
+#ifdef RENDER_CACHE
+            if (fromCache)
+                t = cachedTime(c.anim, t);
+#endif
+            AnimationDriver::evaluate(c.anim, t, color);
+            if (!(samples[s] == Timeline::rgb{color[0], color[1], color[2]}))
+                break;
+        }
+        if (s < c.ticks.size())
+        {
+            printf("FAIL %s: evaluate() gives %u,%u,%u at t=%u ms, driver gave %u,%u,%u\n", c.name.c_str(), color[0], color[1], color[2],
+                   c.ticks[s], samples[s].r, samples[s].g, samples[s].b);
+            failures++;
+            continue;
+        }
+
+        if (rec->second == fingerprint(samples))
+            continue;
+
+        // Not bit exact, measure the deviation from the reference math
+        reference(c.anim, c.ticks, expected, step);
+        unsigned worst = 0;
+        size_t worstAt = 0;
+        for (size_t s = 0; s < samples.size(); s++)
+        {
+            const int diff[3] = {samples[s].r - expected[s].r, samples[s].g - expected[s].g, samples[s].b - expected[s].b};
+            for (uint8_t ch = 0; ch < 3; ch++)
+            {
+                if ((unsigned)abs(diff[ch]) > worst)
+                {
+                    worst = abs(diff[ch]);
+                    worstAt = s;
+                }
+            }
+        }
+        if (worst > tolerance)
+        {
+            printf("FAIL %s: off by %u at t=%u ms (got %u,%u,%u expected %u,%u,%u)\n", c.name.c_str(), worst, c.ticks[worstAt],
+                   samples[worstAt].r, samples[worstAt].g, samples[worstAt].b, expected[worstAt].r, expected[worstAt].g, expected[worstAt].b);
+            failures++;
+        }
+        else
+        {
+            approximate++;
+        }
+    }
+    printf("golden: %zu traces, %zu bit exact, %u within tolerance %u, %u failed\n",
+           cases.size(), cases.size() - approximate - failures, approximate, tolerance, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+#include "KeyframeReducer.h"
+#include <string.h>
+
+namespace KeyframeReducer
+{
+    static AnimationDriver::animFrame toFrame(const sample &s)
+    {
+        AnimationDriver::animFrame f;
+        memcpy(f.color, s.color, 3);
+        f.time = s.time;
+        return f;
+    }
+
+    // Worst channel error between samples[first..last] and the device's interpolation of the two ends
+    static uint8_t segmentError(const std::vector<sample> &samples, size_t first, size_t last, size_t &worstAt)
+    {
+        AnimationDriver::animFrame a = toFrame(samples[first]);
+        AnimationDriver::animFrame b = toFrame(samples[last]);
+        uint8_t worst = 0;
+        worstAt = first;
+        for (size_t i = first + 1; i < last; i++)
+        {
+            uint8_t played[3];
+            AnimationDriver::interpolate(a, b, samples[i].time, played);
+            for (uint8_t c = 0; c < 3; c++)
+            {
+                uint8_t diff = played[c] > samples[i].color[c] ? played[c] - samples[i].color[c] : samples[i].color[c] - played[c];
+                if (diff > worst)
+                {
+                    worst = diff;
+                    worstAt = i;
+                }
+            }
+        }
+        return worst;
+    }
+
+    std::vector<size_t> simplify(const std::vector<sample> &samples, uint8_t maxError)
+    {
+        std::vector<size_t> keys;
+        if (samples.empty())
+            return keys;
+        std::vector<bool> keep(samples.size(), false);
+        keep.front() = keep.back() = true;
+
+        // Explicit stack instead of recursion, long timelines would otherwise nest deeply
+        std::vector<std::pair<size_t, size_t>> pending;
+        pending.push_back(std::make_pair((size_t)0, samples.size() - 1));
+        while (!pending.empty())
+        {
+            std::pair<size_t, size_t> seg = pending.back();
+            pending.pop_back();
+            if (seg.second - seg.first < 2)
+                continue;
+            size_t split;
+            if (segmentError(samples, seg.first, seg.second, split) > maxError)
+            {
+                keep[split] = true;
+                pending.push_back(std::make_pair(seg.first, split));
+                pending.push_back(std::make_pair(split, seg.second));
+            }
+        }
+        for (size_t i = 0; i < samples.size(); i++)
+            if (keep[i])
+                keys.push_back(i);
+
+        // Douglas-Peucker can keep points a later split made redundant, drop any whose neighbours already cover it
+        for (size_t k = 1; k + 1 < keys.size();)
+        {
+            size_t unused;
+            if (segmentError(samples, keys[k - 1], keys[k + 1], unused) <= maxError)
+                keys.erase(keys.begin() + k);
+            else
+                k++;
+        }
+        return keys;
+    }
+
+    uint8_t error(const std::vector<sample> &samples, const std::vector<size_t> &keys)
+    {
+        uint8_t worst = 0;
+        for (size_t k = 1; k < keys.size(); k++)
+        {
+            size_t unused;
+            uint8_t e = segmentError(samples, keys[k - 1], keys[k], unused);
+            if (e > worst)
+                worst = e;
+        }
+        return worst;
+    }
+
+    bool reduce(const std::vector<sample> &samples, uint8_t maxError, uint8_t maxFrames, AnimationDriver::animation &out, uint8_t &reached)
+    {
+        // Both endpoints are always kept, the lamp needs 2 frames and a non zero period to play anything
+        if (samples.size() < 2 || maxFrames < 2)
+            return false;
+        for (size_t i = 1; i < samples.size(); i++)
+            if (samples[i].time <= samples[i - 1].time)
+                return false;
+
+        // Key count only shrinks as the bound grows, so binary search the smallest bound that fits
+        std::vector<size_t> keys = simplify(samples, maxError);
+        reached = maxError;
+        if (keys.size() > maxFrames)
+        {
+            unsigned lo = maxError + 1, hi = 255;
+            std::vector<size_t> best = simplify(samples, 255);
+            reached = 255;
+            while (lo < hi)
+            {
+                unsigned mid = (lo + hi) / 2;
+                std::vector<size_t> attempt = simplify(samples, mid);
+                if (attempt.size() <= maxFrames)
+                {
+                    best = attempt;
+                    reached = mid;
+                    hi = mid;
+                }
+                else
+                {
+                    lo = mid + 1;
+                }
+            }
+            keys = best;
+        }
+
+        // Timestamps are stored relative to the first kept sample, the lamp starts every animation at 0
+        memset(&out, 0, sizeof(out));
+        out.frameCount = keys.size();
+        uint32_t start = samples[keys.front()].time;
+        for (size_t k = 0; k < keys.size(); k++)
+        {
+            out.frames[k] = toFrame(samples[keys[k]]);
+            out.frames[k].time -= start;
+        }
+        out.time = out.frames[out.frameCount - 1].time;
+        return true;
+    }
+
+} // namespace KeyframeReducer
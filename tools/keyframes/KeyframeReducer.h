@@ -0,0 +1,39 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#ifndef ANIMATION
+#include <AnimationDriver.h>
+#endif
+#define KEYFRAME_REDUCER // Used to stop duplicate imports
+
+// Reduces a dense color timeline to as few keyframes as the lamp needs to replay it within an error bound
+namespace KeyframeReducer
+{
+    // One dense input sample
+    struct sample
+    {
+        uint32_t time; // ms from the start, strictly increasing
+        uint8_t color[3];
+    };
+
+    /**
+     * Douglas-Peucker style simplification: keep the endpoints, then recursively keep the sample that the
+     * device would reproduce worst until every sample is within maxError on every channel.
+     * The error is measured with AnimationDriver::interpolate, i.e. the same math the lamp plays back with.
+     * @return indices into samples of the kept keyframes, in order
+     */
+    std::vector<size_t> simplify(const std::vector<sample> &samples, uint8_t maxError);
+
+    // Largest per-channel error over all samples when playing back only the given keyframes
+    uint8_t error(const std::vector<sample> &samples, const std::vector<size_t> &keys);
+
+    /**
+     * Fits the timeline into at most maxFrames keyframes, raising the error bound only as far as needed
+     * @param maxError starting error bound
+     * @param reached receives the error bound that was actually used
+     * @return false if the samples can't be represented (fewer than 2, or times not increasing). Otherwise the first and
+     *         last sample are both kept, so out has at least 2 frames and a non zero period
+     */
+    bool reduce(const std::vector<sample> &samples, uint8_t maxError, uint8_t maxFrames, AnimationDriver::animation &out, uint8_t &reached);
+
+} // namespace KeyframeReducer
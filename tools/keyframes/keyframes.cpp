@@ -0,0 +1,119 @@
+/**
+ * LocalMoodLamp/tools/keyframes
+ *
+ * Turns a dense color timeline into the smallest keyframe animation the lamp can replay within an error bound.
+ *
+ * Usage:
+ *  keyframes timeline.csv [-e maxError] [-n maxFrames] [--slot N] [-o dump.bin]
+ *
+ * The CSV holds "t,r,g,b" rows (t in ms), render's "anim,t,r,g,b" output is accepted too and a header row is skipped.
+ * The result is printed and optionally written as a slot dump ready for upload.
+ */
+
+#include <AnimationDriver.h>
+#include "../common/AnimationIO.h"
+#include "KeyframeReducer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static bool readCsv(const char *path, std::vector<KeyframeReducer::sample> &out)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+        // Use the last four numeric columns so a leading name column is ignored
+        unsigned long v[4];
+        char *cols[8];
+        int n = 0;
+        for (char *tok = strtok(line, ",\r\n"); tok && n < 8; tok = strtok(nullptr, ",\r\n"))
+            cols[n++] = tok;
+        if (n < 4)
+            continue;
+        bool numeric = true;
+        for (int c = 0; c < 4; c++)
+        {
+            char *end;
+            v[c] = strtoul(cols[n - 4 + c], &end, 10);
+            numeric = numeric && end != cols[n - 4 + c];
+        }
+        if (!numeric)
+            continue;
+        KeyframeReducer::sample s;
+        s.time = v[0];
+        s.color[0] = v[1];
+        s.color[1] = v[2];
+        s.color[2] = v[3];
+        out.push_back(s);
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: keyframes timeline.csv [-e maxError] [-n maxFrames] [--slot N] [-o dump.bin]\n");
+        return 2;
+    }
+    unsigned maxError = 2;
+    unsigned maxFrames = MAX_FRAMES;
+    unsigned slotIndex = 0;
+    const char *outPath = nullptr;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-e") == 0)
+            maxError = strtoul(argv[i + 1], nullptr, 0);
+        else if (strcmp(argv[i], "-n") == 0)
+            maxFrames = strtoul(argv[i + 1], nullptr, 0);
+        else if (strcmp(argv[i], "--slot") == 0)
+            slotIndex = strtoul(argv[i + 1], nullptr, 0);
+        else if (strcmp(argv[i], "-o") == 0)
+            outPath = argv[i + 1];
+    }
+    if (maxFrames > MAX_FRAMES)
+        maxFrames = MAX_FRAMES;
+    if (maxError > 255)
+        maxError = 255;
+
+    std::vector<KeyframeReducer::sample> samples;
+    if (!readCsv(argv[1], samples) || samples.size() < 2)
+    {
+        fprintf(stderr, "keyframes: %s needs at least 2 samples\n", argv[1]);
+        return 1;
+    }
+
+    AnimationIO::slot result;
+    result.index = slotIndex;
+    uint8_t reached;
+    if (!KeyframeReducer::reduce(samples, maxError, maxFrames, result.anim, reached))
+    {
+        fprintf(stderr, "keyframes: timestamps must be strictly increasing\n");
+        return 1;
+    }
+    std::vector<size_t> keys = KeyframeReducer::simplify(samples, reached);
+    printf("%zu samples -> %u frames (%zu bytes on the wire), max channel error %u",
+           samples.size(), result.anim.frameCount, AnimationIO::META_BYTES + result.anim.frameCount * AnimationIO::FRAME_BYTES,
+           KeyframeReducer::error(samples, keys));
+    if (reached > maxError)
+        printf(" (bound raised from %u to fit %u frames)", maxError, maxFrames);
+    printf("\n");
+    for (uint8_t i = 0; i < result.anim.frameCount; i++)
+    {
+        const AnimationDriver::animFrame &f = result.anim.frames[i];
+        printf("  %6u ms  %3u %3u %3u\n", (unsigned)f.time, f.color[0], f.color[1], f.color[2]);
+    }
+
+    if (outPath && !AnimationIO::writeDump(outPath, std::vector<AnimationIO::slot>(1, result)))
+    {
+        fprintf(stderr, "keyframes: could not write %s\n", outPath);
+        return 1;
+    }
+    return 0;
+}
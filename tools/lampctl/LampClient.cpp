@@ -0,0 +1,519 @@
+#include "LampClient.h"
+#include <Checksum.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static speed_t baudFlag(unsigned baud)
+{
+    switch (baud)
+    {
+    case 9600:
+        return B9600;
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    case 57600:
+        return B57600;
+    case 230400:
+        return B230400;
+    case 460800:
+        return B460800;
+    case 921600:
+        return B921600;
+    default:
+        return B115200;
+    }
+}
+
+LampClient::LampClient() : fd(-1), ownsFd(false), timeoutMs(2000), transfer(), started(0) {}
+
+LampClient::~LampClient()
+{
+    close();
+}
+
+bool LampClient::open(const std::string &port, unsigned baud)
+{
+    close();
+    int f = ::open(port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (f < 0)
+        return fail("open " + port + ": " + strerror(errno));
+    termios tio;
+    if (tcgetattr(f, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, baudFlag(baud));
+        cfsetospeed(&tio, baudFlag(baud));
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(f, TCSANOW, &tio);
+    }
+    tcflush(f, TCIOFLUSH);
+    openFd(f);
+    ownsFd = true;
+    return true;
+}
+
+bool LampClient::openFd(int f)
+{
+    close();
+    fd = f;
+    ownsFd = false;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    rx.clear();
+    return true;
+}
+
+void LampClient::close()
+{
+    if (fd >= 0 && ownsFd)
+        ::close(fd);
+    fd = -1;
+    rx.clear();
+}
+
+bool LampClient::fail(const std::string &msg)
+{
+    error = msg;
+    return false;
+}
+
+void LampClient::begin()
+{
+    transfer = transferStats();
+    started = now();
+}
+
+void LampClient::end()
+{
+    transfer.seconds = now() - started;
+}
+
+bool LampClient::writeAll(const uint8_t *data, size_t len)
+{
+    while (len)
+    {
+        ssize_t n = ::write(fd, data, len);
+        if (n > 0)
+        {
+            data += n;
+            len -= n;
+            transfer.bytesOut += n;
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR)
+            return fail(std::string("write: ") + strerror(errno));
+        pollfd p = {fd, POLLOUT, 0};
+        if (poll(&p, 1, timeoutMs) <= 0)
+            return fail("write timed out");
+    }
+    return true;
+}
+
+// Pull whatever is available into rx, waiting up to the timeout for at least one byte
+bool LampClient::fill(int waitMs)
+{
+    pollfd p = {fd, POLLIN, 0};
+    int ready = poll(&p, 1, waitMs);
+    if (ready <= 0)
+        return fail("timed out waiting for the lamp");
+    uint8_t chunk[512];
+    ssize_t n = ::read(fd, chunk, sizeof(chunk));
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return true;
+    if (n <= 0)
+        return fail("serial port closed");
+    rx.insert(rx.end(), chunk, chunk + n);
+    transfer.bytesIn += n;
+    return true;
+}
+
+bool LampClient::readExact(uint8_t *out, size_t len)
+{
+    double deadline = now() + timeoutMs / 1000.0;
+    while (rx.size() < len)
+    {
+        int left = (int)((deadline - now()) * 1000);
+        if (left <= 0 || !fill(left))
+            return fail("timed out reading " + std::to_string(len) + " bytes");
+    }
+    memcpy(out, rx.data(), len);
+    rx.erase(rx.begin(), rx.begin() + len);
+    return true;
+}
+
+bool LampClient::readLine(std::string &line)
+{
+    double deadline = now() + timeoutMs / 1000.0;
+    while (true)
+    {
+        for (size_t i = 0; i < rx.size(); i++)
+        {
+            if (rx[i] == '\n')
+            {
+                line.assign(rx.begin(), rx.begin() + i);
+                if (!line.empty() && line[line.size() - 1] == '\r')
+                    line.erase(line.size() - 1);
+                rx.erase(rx.begin(), rx.begin() + i + 1);
+                return true;
+            }
+        }
+        int left = (int)((deadline - now()) * 1000);
+        if (left <= 0 || !fill(left))
+            return fail("timed out waiting for a line");
+    }
+}
+
+bool LampClient::sendIntent(const std::string &code)
+{
+    std::string msg = code + "-";
+    return writeAll((const uint8_t *)msg.data(), msg.size());
+}
+
+bool LampClient::expectReady(const std::string &code)
+{
+    std::string line;
+    if (!readLine(line))
+        return false;
+    if (line != "ready_" + code)
+        return fail("unexpected handshake \"" + line + "\"");
+    return true;
+}
+
+// Send the intent and packet for one upload or preview
+bool LampClient::sendPacket(const AnimationIO::slot &s, char intent, std::vector<uint8_t> &packet)
+{
+    if (s.index >= LAMP_SLOTS || s.anim.frameCount > MAX_FRAMES)
+        return fail("slot " + std::to_string(s.index) + " is out of range or has too many frames");
+    packet.clear();
+    AnimationIO::encode(s, packet);
+    std::vector<uint8_t> msg;
+    msg.push_back(intent);
+    msg.push_back('-');
+    msg.insert(msg.end(), packet.begin(), packet.end());
+    return writeAll(msg.data(), msg.size());
+}
+
+// Read the handshake and echo of one upload and acknowledge it if the echo matches
+bool LampClient::ackUpload(const std::vector<uint8_t> &packet, char intent, double sent)
+{
+    if (!expectReady(std::string(1, intent)))
+        return false;
+    if (!transfer.handshakeMs)
+        transfer.handshakeMs = (now() - sent) * 1000;
+    std::vector<uint8_t> echo(packet.size());
+    if (!readExact(echo.data(), echo.size()))
+        return false;
+    // Anything but the ACK makes the lamp reset, so only send it for an exact echo
+    uint8_t ack = echo == packet ? LAMP_ACK : 0x00;
+    if (!writeAll(&ack, 1))
+        return false;
+    if (ack != LAMP_ACK)
+        return fail("echo mismatch on slot " + std::to_string(packet[0]));
+    return true;
+}
+
+// Wait for the lamp to report the slot was written
+bool LampClient::waitDone()
+{
+    std::string line;
+    if (!readLine(line))
+        return false;
+    if (line != "Done")
+        return fail("upload not confirmed: \"" + line + "\"");
+    return true;
+}
+
+bool LampClient::upload(const AnimationIO::slot &s)
+{
+    return uploadAll(std::vector<AnimationIO::slot>(1, s), false);
+}
+
+bool LampClient::uploadAll(const std::vector<AnimationIO::slot> &slots, bool pipelined)
+{
+    begin();
+    std::vector<uint8_t> current, next;
+    double sent = now();
+    if (slots.empty() || !sendPacket(slots[0], '0' + slots[0].index, current))
+        return slots.empty();
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        bool more = i + 1 < slots.size();
+        if (!ackUpload(current, '0' + current[0], sent))
+            return false;
+        // Queue the next request while the lamp is still writing storage, it is read as soon as loop() comes back around
+        if (pipelined && more && !sendPacket(slots[i + 1], '0' + slots[i + 1].index, next))
+            return false;
+        if (!waitDone())
+            return false;
+        if (!pipelined && more && !sendPacket(slots[i + 1], '0' + slots[i + 1].index, next))
+            return false;
+        current.swap(next);
+    }
+    end();
+    return true;
+}
+
+bool LampClient::preview(const AnimationIO::slot &s)
+{
+    begin();
+    std::vector<uint8_t> packet;
+    double sent = now();
+    if (!sendPacket(s, 'p', packet) || !ackUpload(packet, 'p', sent) || !waitDone())
+        return false;
+    end();
+    return true;
+}
+
+bool LampClient::stream(const std::vector<AnimationIO::slot> &slots, double intervalMs, streamStats &stats)
+{
+    begin();
+    stats = streamStats();
+    if (intervalMs <= 0)
+        return fail("stream interval has to be positive");
+    std::vector<uint8_t> packet;
+    double total = 0;
+    size_t next = 0;
+    while (next < slots.size())
+    {
+        double wait = started + next * intervalMs / 1000 - now();
+        if (wait > 0)
+        {
+            usleep((useconds_t)(wait * 1e6));
+        }
+        else
+        {
+            // Behind schedule, skip to whatever is due now so the lamp shows the live state instead of a backlog
+            size_t due = (size_t)((now() - started) * 1000 / intervalMs);
+            if (due >= slots.size())
+                due = slots.size() - 1;
+            if (due > next)
+            {
+                stats.skipped += due - next;
+                next = due;
+            }
+        }
+        double sent = now();
+        if (!sendPacket(slots[next], 'p', packet) || !ackUpload(packet, 'p', sent) || !waitDone())
+            return false;
+        double ms = (now() - sent) * 1000;
+        total += ms;
+        if (ms > stats.maxMs)
+            stats.maxMs = ms;
+        stats.sent++;
+        next++;
+    }
+    stats.meanMs = stats.sent ? total / stats.sent : 0;
+    end();
+    return true;
+}
+
+bool LampClient::commit()
+{
+    begin();
+    if (!sendIntent("c"))
+        return false;
+    double sent = now();
+    if (!expectReady("c"))
+        return false;
+    transfer.handshakeMs = (now() - sent) * 1000;
+    std::string line;
+    if (!readLine(line))
+        return false;
+    if (line != "Done")
+        return fail("nothing is being previewed");
+    end();
+    return true;
+}
+
+bool LampClient::download(std::vector<AnimationIO::slot> &out, bool pipelined)
+{
+    begin();
+    out.clear();
+    if (!sendIntent("d"))
+        return false;
+    double sent = now();
+    // Three acknowledges per slot: before the header, after the header and after the frames
+    if (pipelined)
+    {
+        std::vector<uint8_t> acks(LAMP_SLOTS * 3, LAMP_ACK);
+        if (!writeAll(acks.data(), acks.size()))
+            return false;
+    }
+    if (!expectReady("d"))
+        return false;
+    transfer.handshakeMs = (now() - sent) * 1000;
+
+    const uint8_t ack = LAMP_ACK;
+    for (uint8_t i = 0; i < LAMP_SLOTS; i++)
+    {
+        std::vector<uint8_t> record(AnimationIO::META_BYTES);
+        if (!pipelined && !writeAll(&ack, 1))
+            return false;
+        if (!readExact(record.data(), AnimationIO::META_BYTES))
+            return false;
+        if (record[0] != i || record[1] > MAX_FRAMES)
+            return fail("bad header for slot " + std::to_string(i));
+        if (!pipelined && !writeAll(&ack, 1))
+            return false;
+        record.resize(AnimationIO::META_BYTES + record[1] * AnimationIO::FRAME_BYTES);
+        if (!readExact(&record[AnimationIO::META_BYTES], record.size() - AnimationIO::META_BYTES))
+            return false;
+        if (!pipelined && !writeAll(&ack, 1))
+            return false;
+        size_t pos = 0;
+        AnimationIO::slot s;
+        AnimationIO::decode(record, pos, s);
+        out.push_back(s);
+    }
+    end();
+    return true;
+}
+
+bool LampClient::readImage(std::vector<uint8_t> &image)
+{
+    begin();
+    if (!sendIntent("r"))
+        return false;
+    double sent = now();
+    if (!expectReady("r"))
+        return false;
+    transfer.handshakeMs = (now() - sent) * 1000;
+    uint8_t size[2], crc[2];
+    if (!readExact(size, 2))
+        return false;
+    image.resize(size[0] << 8 | size[1]);
+    if (!readExact(image.data(), image.size()) || !readExact(crc, 2))
+        return false;
+    if ((crc[0] << 8 | crc[1]) != Checksum::crc16(CRC16_INIT, image.data(), image.size()))
+        return fail("image checksum mismatch");
+    end();
+    return true;
+}
+
+bool LampClient::writeImage(const std::vector<uint8_t> &image)
+{
+    begin();
+    if (image.empty() || image.size() > 0xFFFF)
+        return fail("image size out of range");
+    if (!sendIntent("w"))
+        return false;
+    double sent = now();
+    if (!expectReady("w"))
+        return false;
+    transfer.handshakeMs = (now() - sent) * 1000;
+    const uint8_t size[2] = {(uint8_t)(image.size() >> 8), (uint8_t)image.size()};
+    if (!writeAll(size, 2))
+        return false;
+    // Page size, or the start of an empty error line
+    uint8_t page;
+    if (!readExact(&page, 1))
+        return false;
+    if (page == '\r' || page == 0)
+        return fail("image is not the size of the lamp's storage");
+    for (size_t pos = 0; pos < image.size(); pos += page)
+    {
+        uint8_t credit = LAMP_CREDIT;
+        if (pos && !readExact(&credit, 1))
+            return false;
+        if (credit != LAMP_CREDIT)
+            return fail("restore aborted at byte " + std::to_string(pos));
+        if (!writeAll(&image[pos], image.size() - pos < page ? image.size() - pos : page))
+            return false;
+    }
+    uint16_t crc = Checksum::crc16(CRC16_INIT, image.data(), image.size());
+    const uint8_t tail[2] = {(uint8_t)(crc >> 8), (uint8_t)crc};
+    if (!writeAll(tail, 2))
+        return false;
+    std::string line;
+    if (!readLine(line))
+        return false;
+    if (line != "Done")
+        return fail("restore not confirmed: \"" + line + "\"");
+    end();
+    return true;
+}
+
+bool LampClient::stats(std::vector<uint8_t> &raw)
+{
+    begin();
+    if (!sendIntent("s"))
+        return false;
+    double sent = now();
+    if (!expectReady("s"))
+        return false;
+    transfer.handshakeMs = (now() - sent) * 1000;
+    uint8_t header[3];
+    if (!readExact(header, 1))
+        return false;
+    if (header[0] != 'P')
+        return fail("lamp was built without -D PROFILE");
+    if (!readExact(header + 1, 2))
+        return false;
+    // Each section is four uint32 fields, each bin a uint16
+    raw.assign(header, header + 3);
+    raw.resize(3 + header[1] * 16 + header[2] * 2);
+    if (!readExact(&raw[3], raw.size() - 3))
+        return false;
+    end();
+    return true;
+}
+
+bool LampClient::tasks(std::vector<uint8_t> &raw)
+{
+    begin();
+    if (!sendIntent("t"))
+        return false;
+    double sent = now();
+    if (!expectReady("t"))
+        return false;
+    transfer.handshakeMs = (now() - sent) * 1000;
+    uint8_t header[2];
+    if (!readExact(header, 2))
+        return false;
+    if (header[0] != 'T')
+        return fail("lamp has no task scheduler");
+    // Each task is three uint32 fields, then the uint32 window
+    raw.assign(header, header + 2);
+    raw.resize(2 + header[1] * 12 + 4);
+    if (!readExact(&raw[2], raw.size() - 2))
+        return false;
+    end();
+    return true;
+}
+
+bool LampClient::rxStats(std::vector<uint8_t> &raw)
+{
+    begin();
+    if (!sendIntent("b"))
+        return false;
+    double sent = now();
+    if (!expectReady("b"))
+        return false;
+    transfer.handshakeMs = (now() - sent) * 1000;
+    uint8_t header;
+    if (!readExact(&header, 1))
+        return false;
+    if (header != 'B')
+        return fail("lamp has no receive ring");
+    // Two uint16 fields, then three uint32
+    raw.assign(1, header);
+    raw.resize(1 + 16);
+    if (!readExact(&raw[1], raw.size() - 1))
+        return false;
+    end();
+    return true;
+}
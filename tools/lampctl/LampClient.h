@@ -0,0 +1,98 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "../common/AnimationIO.h"
+#define LAMP_CLIENT // Used to stop duplicate imports
+
+// Number of animation slots the lamp sends back on a download
+#define LAMP_SLOTS 6
+// Acknowledge byte the lamp waits for after every transfer step
+#define LAMP_ACK 0xFF
+// Byte the lamp sends when it is ready for the next page of an image restore
+#define LAMP_CREDIT 0x11
+
+/**
+ * Host side of the lamp's serial protocol (see handleSerial() in main.cpp):
+ *  "<intent>-" -> "ready_<intent>\r\n", then the intent specific exchange
+ * All I/O is non-blocking with poll() deadlines, so a stuck lamp turns into an error instead of a hang.
+ */
+class LampClient
+{
+public:
+    // Timing of the most recent operation
+    struct transferStats
+    {
+        size_t bytesOut;
+        size_t bytesIn;
+        double seconds;     // Whole operation
+        double handshakeMs; // Intent sent -> ready line received (first one for bulk operations)
+    };
+
+    // Outcome of a stream() run
+    struct streamStats
+    {
+        size_t sent;
+        size_t skipped; // Animations whose turn passed while the lamp was still busy with an earlier one
+        double meanMs;  // Preview sent -> lamp playing it
+        double maxMs;
+    };
+
+    LampClient();
+    ~LampClient();
+
+    bool open(const std::string &port, unsigned baud = 115200);
+    bool openFd(int fd); // Use an already open descriptor, e.g. one end of a PTY
+    void close();
+
+    // Upload a single slot, the lamp echoes the packet and it is acknowledged only if the echo matches
+    bool upload(const AnimationIO::slot &);
+    // Upload several slots, with pipelined set the next request is queued as soon as the previous one is acknowledged.
+    // Only safe where the link is flow controlled (USB CDC), a UART lamp can overrun its receive buffer while writing EEPROM
+    bool uploadAll(const std::vector<AnimationIO::slot> &, bool pipelined);
+    // Play an animation straight from the lamp's RAM, nothing is written to storage
+    bool preview(const AnimationIO::slot &);
+    // Store the animation being previewed in the slot it was previewed for
+    bool commit();
+    // Live stream: preview each animation in turn, one every intervalMs. Flow controlled, a preview only goes out once
+    // the lamp confirmed the last one, and a lamp that falls behind is caught up by jumping to the animation that is due
+    bool stream(const std::vector<AnimationIO::slot> &, double intervalMs, streamStats &);
+    // Download every slot, with pipelined set all acknowledges are sent up front instead of one per step
+    bool download(std::vector<AnimationIO::slot> &out, bool pipelined);
+    // Read the lamp's whole storage in one burst, checked against the CRC16 the lamp sends with it
+    bool readImage(std::vector<uint8_t> &image);
+    // Overwrite the lamp's whole storage, the image has to be exactly the size readImage() returns
+    bool writeImage(const std::vector<uint8_t> &image);
+    // Fetch the raw profiler block of a -D PROFILE build ('P', section count, bin count, stats)
+    bool stats(std::vector<uint8_t> &raw);
+    // Fetch the raw task run times ('T', task count, runs/total/max per task, window), any build
+    bool tasks(std::vector<uint8_t> &raw);
+    // Fetch the raw receive ring stats ('B', capacity, high water, overflows, stalls, bytes received), resets them on the lamp
+    bool rxStats(std::vector<uint8_t> &raw);
+
+    const std::string &lastError() const { return error; }
+    const transferStats &lastTransfer() const { return transfer; }
+    void setTimeout(int ms) { timeoutMs = ms; }
+
+private:
+    int fd;
+    bool ownsFd;
+    int timeoutMs;
+    std::vector<uint8_t> rx; // Bytes read ahead of what callers asked for
+    std::string error;
+    transferStats transfer;
+    double started;
+
+    bool fail(const std::string &);
+    void begin();
+    void end();
+    bool writeAll(const uint8_t *, size_t);
+    bool fill(int deadlineMs);
+    bool readExact(uint8_t *, size_t);
+    bool readLine(std::string &);
+    bool sendIntent(const std::string &code);
+    bool expectReady(const std::string &code);
+    bool sendPacket(const AnimationIO::slot &, char intent, std::vector<uint8_t> &packet);
+    bool ackUpload(const std::vector<uint8_t> &packet, char intent, double sent);
+    bool waitDone();
+};
@@ -0,0 +1,309 @@
+/**
+ * LocalMoodLamp/tools/lampctl
+ *
+ * Command line client for the lamp's serial protocol.
+ *
+ * Usage:
+ *  lampctl PORT upload dump.bin [--pipeline]     Upload every slot in a slot dump
+ *  lampctl PORT download dump.bin [--pipeline]   Save all slots to a slot dump
+ *  lampctl PORT preview dump.bin [N]             Play the Nth record of a dump from RAM (default first), storage is untouched
+ *  lampctl PORT commit                           Store the animation being previewed in its slot
+ *  lampctl PORT stream dump.bin [FPS]            Preview the records of a dump one after another, FPS a second (default 10)
+ *  lampctl PORT backup file.img                  Save the raw storage image
+ *  lampctl PORT restore file.img                 Write a raw storage image back
+ *  lampctl PORT clone PORT2                      Copy the storage of one lamp onto another
+ *  lampctl PORT stats                            Print profiler stats of a -D PROFILE build
+ *  lampctl PORT tasks                            Print run time and CPU share of each scheduler task
+ *  lampctl PORT rx                               Print receive ring fill level, drops and stalls since the last call
+ *  lampctl PORT bench [N] [--pipeline]           Time N downloads
+ *
+ * Every transfer reports bytes moved, throughput and the intent -> ready handshake latency.
+ */
+
+#include "LampClient.h"
+#include <Profiler.h>
+#include <Tasks.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Names in the order the lamp reports them, from the firmware's own lists
+static const char *sectionNames[] = {PROFILE_SECTIONS(PROFILE_SECTION_NAME)};
+static const char *taskNames[] = {LAMP_TASKS(LAMP_TASK_NAME)};
+
+static void usage()
+{
+    fprintf(stderr, "usage: lampctl PORT (upload dump.bin | download dump.bin | preview dump.bin [N] | commit | stream dump.bin [FPS] | backup file.img | restore file.img | clone PORT2 | stats | tasks | rx | bench [N]) [--pipeline]\n");
+    exit(2);
+}
+
+static void report(const char *what, const LampClient &lamp)
+{
+    const LampClient::transferStats &t = lamp.lastTransfer();
+    printf("%s: %zu bytes out, %zu bytes in, %.1f ms, %.2f kB/s, handshake %.2f ms\n", what, t.bytesOut, t.bytesIn,
+           t.seconds * 1000, (t.bytesOut + t.bytesIn) / t.seconds / 1000, t.handshakeMs);
+}
+
+static bool readFile(const std::string &path, std::vector<uint8_t> &out)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    out.clear();
+    int c;
+    while ((c = fgetc(f)) != EOF)
+        out.push_back(c);
+    fclose(f);
+    return true;
+}
+
+static bool writeFile(const std::string &path, const std::vector<uint8_t> &data)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void printStats(const std::vector<uint8_t> &raw)
+{
+    uint8_t sections = raw[1], bins = raw[2];
+    const uint8_t *p = &raw[3];
+    printf("%-12s %10s %10s %10s %10s\n", "section", "count", "min us", "mean us", "max us");
+    for (uint8_t s = 0; s < sections; s++, p += 16)
+    {
+        uint32_t count = le32(p + 12);
+        printf("%-12s %10u %10u %10.1f %10u\n", s < sizeof(sectionNames) / sizeof(*sectionNames) ? sectionNames[s] : "?",
+               count, le32(p), count ? (double)le32(p + 8) / count : 0.0, le32(p + 4));
+    }
+    printf("loop time histogram:\n");
+    for (uint8_t b = 0; b < bins; b++, p += 2)
+    {
+        unsigned n = p[0] | p[1] << 8;
+        if (n)
+            printf("  < %7lu us: %u\n", 2UL << b, n);
+    }
+}
+
+static void printTasks(const std::vector<uint8_t> &raw)
+{
+    uint8_t count = raw[1];
+    const uint8_t *p = &raw[2];
+    uint32_t window = le32(p + count * 12);
+    uint32_t busy = 0;
+    printf("%-8s %10s %10s %10s %8s\n", "task", "runs", "mean us", "max us", "cpu %");
+    for (uint8_t t = 0; t < count; t++, p += 12)
+    {
+        uint32_t runs = le32(p), total = le32(p + 4);
+        busy += total;
+        printf("%-8s %10u %10.1f %10u %8.2f\n", t < sizeof(taskNames) / sizeof(*taskNames) ? taskNames[t] : "?", runs,
+               runs ? (double)total / runs : 0.0, le32(p + 8), window ? 100.0 * total / window : 0.0);
+    }
+    printf("%-8s %10s %10s %10s %8.2f\n", "idle", "", "", "", window ? 100.0 * (window - (busy < window ? busy : window)) / window : 0.0);
+    printf("window %.3f s\n", window / 1e6);
+}
+
+static void printRx(const std::vector<uint8_t> &raw)
+{
+    uint16_t capacity = raw[1] | raw[2] << 8, highWater = raw[3] | raw[4] << 8;
+    uint32_t overflows = le32(&raw[5]), stalls = le32(&raw[9]), received = le32(&raw[13]);
+    printf("ring       %u bytes\n", capacity);
+    printf("high water %u bytes (%.0f %%)\n", highWater, capacity ? 100.0 * highWater / capacity : 0.0);
+    printf("received   %u bytes\n", received);
+    printf("overflows  %u\n", overflows);
+    printf("stalls     %u\n", stalls);
+    // Overflows are bytes the UART core dropped (NANO only, USB lamps always report 0), stalls only mean the core held bytes the ring had no room for
+    if (overflows)
+        printf("bytes were lost, keep bursts below %u bytes or wait for acknowledges (drop --pipeline)\n", capacity);
+    else if (stalls)
+        printf("the ring filled up but nothing was lost\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+        usage();
+    bool pipelined = false;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--pipeline") == 0)
+            pipelined = true;
+        else
+            args.push_back(argv[i]);
+    }
+
+    LampClient lamp;
+    if (!lamp.open(args[0]))
+    {
+        fprintf(stderr, "lampctl: %s\n", lamp.lastError().c_str());
+        return 1;
+    }
+    const std::string &cmd = args[1];
+    bool ok = false;
+
+    if (cmd == "upload" && args.size() == 3)
+    {
+        std::vector<AnimationIO::slot> slots;
+        if (!AnimationIO::readDump(args[2], slots))
+        {
+            fprintf(stderr, "lampctl: could not read %s\n", args[2].c_str());
+            return 1;
+        }
+        ok = lamp.uploadAll(slots, pipelined);
+        if (ok)
+            report("upload", lamp);
+    }
+    else if (cmd == "download" && args.size() == 3)
+    {
+        std::vector<AnimationIO::slot> slots;
+        ok = lamp.download(slots, pipelined) && AnimationIO::writeDump(args[2], slots);
+        if (ok)
+            report("download", lamp);
+    }
+    else if (cmd == "preview" && (args.size() == 3 || args.size() == 4))
+    {
+        std::vector<AnimationIO::slot> slots;
+        size_t n = args.size() == 4 ? strtoul(args[3].c_str(), nullptr, 0) : 0;
+        if (!AnimationIO::readDump(args[2], slots) || n >= slots.size())
+        {
+            fprintf(stderr, "lampctl: %s has no record %zu\n", args[2].c_str(), n);
+            return 1;
+        }
+        ok = lamp.preview(slots[n]);
+        if (ok)
+            report("preview", lamp);
+    }
+    else if (cmd == "commit" && args.size() == 2)
+    {
+        ok = lamp.commit();
+        if (ok)
+            report("commit", lamp);
+    }
+    else if (cmd == "stream" && (args.size() == 3 || args.size() == 4))
+    {
+        std::vector<AnimationIO::slot> slots;
+        double fps = args.size() == 4 ? strtod(args[3].c_str(), nullptr) : 10;
+        if (!AnimationIO::readDump(args[2], slots) || slots.empty() || fps <= 0)
+        {
+            fprintf(stderr, "lampctl: could not stream %s at %s FPS\n", args[2].c_str(), args.size() == 4 ? args[3].c_str() : "10");
+            return 1;
+        }
+        LampClient::streamStats s;
+        ok = lamp.stream(slots, 1000 / fps, s);
+        if (ok)
+        {
+            report("stream", lamp);
+            printf("%zu sent, %zu skipped, latency mean %.2f ms, max %.2f ms\n", s.sent, s.skipped, s.meanMs, s.maxMs);
+        }
+    }
+    else if (cmd == "backup" && args.size() == 3)
+    {
+        std::vector<uint8_t> image;
+        ok = lamp.readImage(image);
+        if (ok && !writeFile(args[2], image))
+        {
+            fprintf(stderr, "lampctl: could not write %s\n", args[2].c_str());
+            return 1;
+        }
+        if (ok)
+            report("backup", lamp);
+    }
+    else if (cmd == "restore" && args.size() == 3)
+    {
+        std::vector<uint8_t> image;
+        if (!readFile(args[2], image))
+        {
+            fprintf(stderr, "lampctl: could not read %s\n", args[2].c_str());
+            return 1;
+        }
+        ok = lamp.writeImage(image);
+        if (ok)
+            report("restore", lamp);
+    }
+    else if (cmd == "clone" && args.size() == 3)
+    {
+        std::vector<uint8_t> image;
+        LampClient target;
+        if (!target.open(args[2]))
+        {
+            fprintf(stderr, "lampctl: %s\n", target.lastError().c_str());
+            return 1;
+        }
+        ok = lamp.readImage(image);
+        if (ok)
+        {
+            report("read", lamp);
+            if (!target.writeImage(image))
+            {
+                fprintf(stderr, "lampctl: %s\n", target.lastError().c_str());
+                return 1;
+            }
+            report("write", target);
+        }
+    }
+    else if (cmd == "stats" && args.size() == 2)
+    {
+        std::vector<uint8_t> raw;
+        ok = lamp.stats(raw);
+        if (ok)
+            printStats(raw);
+    }
+    else if (cmd == "tasks" && args.size() == 2)
+    {
+        std::vector<uint8_t> raw;
+        ok = lamp.tasks(raw);
+        if (ok)
+            printTasks(raw);
+    }
+    else if (cmd == "rx" && args.size() == 2)
+    {
+        std::vector<uint8_t> raw;
+        ok = lamp.rxStats(raw);
+        if (ok)
+            printRx(raw);
+    }
+    else if (cmd == "bench" && args.size() <= 3)
+    {
+        unsigned runs = args.size() == 3 ? strtoul(args[2].c_str(), nullptr, 0) : 10;
+        double total = 0, fastest = 1e9, slowest = 0, handshake = 0;
+        size_t bytes = 0;
+        std::vector<AnimationIO::slot> slots;
+        ok = true;
+        for (unsigned r = 0; r < runs && ok; r++)
+        {
+            ok = lamp.download(slots, pipelined);
+            const LampClient::transferStats &t = lamp.lastTransfer();
+            total += t.seconds;
+            handshake += t.handshakeMs;
+            bytes += t.bytesIn + t.bytesOut;
+            if (t.seconds < fastest)
+                fastest = t.seconds;
+            if (t.seconds > slowest)
+                slowest = t.seconds;
+        }
+        if (ok && runs)
+            printf("%u downloads: min %.1f ms, mean %.1f ms, max %.1f ms, %.2f kB/s, mean handshake %.2f ms\n", runs,
+                   fastest * 1000, total / runs * 1000, slowest * 1000, bytes / total / 1000, handshake / runs);
+    }
+    else
+    {
+        usage();
+    }
+
+    if (!ok)
+    {
+        fprintf(stderr, "lampctl: %s\n", lamp.lastError().c_str());
+        return 1;
+    }
+    return 0;
+}
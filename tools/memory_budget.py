@@ -0,0 +1,244 @@
+"""
+PlatformIO extra script adding a `budget` target: `pio run -e micro -t budget`
+
+Reports static RAM, flash and RAM per module (from the linker map), worst case stack depth per call path
+(from -fstack-usage and the disassembled call graph) and fails if the RAM left over drops below
+`custom_ram_headroom` bytes (default 256).
+
+Limits of the stack estimate:
+- Indirect calls (function pointers) are resolved with the INDIRECT_CALLS table below
+- Functions without stack usage info (prebuilt libraries, assembly) count as 0 and are listed
+- Recursion is reported and cut at the first repeat
+- Interrupts only nest on top of an ISR that re-enables them first (ISR_NOBLOCK, starts with `sei`), such as the
+  NANO's receive pump. Without one the worst ISR path is added once on top of the worst main path, with one the
+  worst non-blocking ISR path plus the worst other ISR path is
+"""
+import os
+import re
+import subprocess
+
+Import("env")  # noqa: F821 (provided by PlatformIO)
+
+# Caller (substring) -> callee name substrings it may reach through a function pointer
+INDIRECT_CALLS = {
+    # renderTask hands run() showColor, the RENDER_TIMER tick its lambda
+    "AnimationDriver::AnimationDriver::run": ["renderTick::_FUN", "showColor"],
+    # -D RENDER_TIMER: the timer interrupt calls renderTick through a pointer (every AVR vector gets the edge, a safe overestimate)
+    "__vector_": ["renderTick"],
+    "TC3_Handler": ["renderTick"],
+    "Scheduler::run": ["Task", "Ready"],
+    # The receive pump (a timer interrupt on the NANO) reaches the core's Serial through its vtable
+    "SerialRx::pump": ["Serial::available", "Serial::read", "Serial_::available", "Serial_::read"],
+    "AnimationDriver::AnimationDriver::updateTime": ["millis"],
+    "AnimationDriver::AnimationDriver::restart": ["millis"],
+    "AnimationDriver::AnimationDriver::seek": ["millis"],
+}
+
+CALL_RE = re.compile(r"\s(call|rcall|bl|blx|jmp|b\.w)\s.*<([^>+]+)>\s*$")
+INDIRECT_RE = re.compile(r"\s(icall|eicall|blx\s+r\d+)")
+INSN_RE = re.compile(r"^\s*[0-9a-f]+:\t")
+SEI_RE = re.compile(r"\tsei\b")
+FUNC_RE = re.compile(r"^[0-9a-f]+ <(.+)>:$")
+MAP_RE = re.compile(r"^ (\.(?:text|rodata|data|bss|noinit|progmem)[^\s]*)?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+\.o\)?)$")
+
+env.Append(  # noqa: F821
+    CCFLAGS=["-fstack-usage"],
+    LINKFLAGS=["-Wl,-Map,${BUILD_DIR}/firmware.map"],
+)
+
+
+def key(name):
+    """Function identity without return type, parameters or template/lambda details so .su and objdump names line up"""
+    for group in (r"\([^()]*\)", r"<[^<>]*>", r"\{[^{}]*\}"):
+        previous = None
+        while previous != name:
+            previous, name = name, re.sub(group, "", name)
+    return re.sub(r"(::)+", "::", name.split(" ")[-1])
+
+
+def tool(env, name):
+    cc = env.subst("$CC")
+    return cc[: -len("gcc")] + name if cc.endswith("gcc") else name
+
+
+def run(cmd):
+    return subprocess.run(cmd, capture_output=True, text=True, check=True).stdout
+
+
+def stack_usage(build_dir):
+    frames, dynamic = {}, set()
+    for root, _, files in os.walk(build_dir):
+        for f in files:
+            if not f.endswith(".su"):
+                continue
+            for line in open(os.path.join(root, f)):
+                parts = line.rstrip("\n").split("\t")
+                if len(parts) != 3:
+                    continue
+                name = key(parts[0].split(":", 3)[-1])
+                frames[name] = max(frames.get(name, 0), int(parts[1]))
+                if "dynamic" in parts[2] and "bounded" not in parts[2]:
+                    dynamic.add(name)
+    return frames, dynamic
+
+
+def call_graph(objdump, elf):
+    """Call graph, functions with unresolved indirect calls, and functions that open with `sei` (non-blocking ISRs)"""
+    graph, indirect, nonblocking, current, first = {}, set(), set(), None, False
+    for line in run([objdump, "-d", "-C", elf]).splitlines():
+        m = FUNC_RE.match(line)
+        if m:
+            current = key(m.group(1))
+            graph.setdefault(current, set())
+            first = True
+            continue
+        if current is None:
+            continue
+        if first and INSN_RE.match(line):
+            first = False
+            if SEI_RE.search(line):
+                nonblocking.add(current)
+        m = CALL_RE.search(line)
+        if m and key(m.group(2)) != current:
+            graph[current].add(key(m.group(2)))
+        elif INDIRECT_RE.search(line):
+            indirect.add(current)
+    # Resolve function pointers from the table above
+    for caller in list(graph):
+        for pattern, targets in INDIRECT_CALLS.items():
+            if pattern in caller:
+                graph[caller].update(f for f in graph if any(t in f for t in targets))
+    return graph, indirect, nonblocking
+
+
+def worst_path(root, graph, frames, memo, stack=()):
+    if root in stack:
+        return 0, [root + " (recursion)"]
+    if root in memo:
+        return memo[root]
+    best, path = 0, []
+    for callee in graph.get(root, ()):
+        depth, sub = worst_path(callee, graph, frames, memo, stack + (root,))
+        if depth > best:
+            best, path = depth, sub
+    memo[root] = (frames.get(root, 0) + best, [root] + path)
+    return memo[root]
+
+
+def module_sizes(map_path):
+    """Flash and RAM bytes per object file, post garbage collection"""
+    modules, pending = {}, None
+    in_map = False
+    for line in open(map_path, errors="replace"):
+        if line.startswith("Linker script and memory map"):
+            in_map = True
+            continue
+        if not in_map:
+            continue
+        if re.match(r"^ \.\S+$", line.rstrip()):
+            pending = line.strip()
+            continue
+        m = MAP_RE.match(line.rstrip())
+        if not m:
+            pending = None
+            continue
+        section = m.group(1) or pending
+        pending = None
+        size = int(m.group(3), 16)
+        if not section or not size:
+            continue
+        obj = m.group(4)
+        # Group archive members under the archive, keep project objects separate
+        name = os.path.basename(obj.split("(")[0]) if "(" in obj else os.path.basename(obj)
+        flash, ram = modules.get(name, (0, 0))
+        if section.startswith((".text", ".rodata", ".progmem")):
+            flash += size
+        elif section.startswith(".data"):
+            flash += size
+            ram += size
+        else:
+            ram += size
+        modules[name] = (flash, ram)
+    return modules
+
+
+def report(target, source, env):
+    build_dir = env.subst("$BUILD_DIR")
+    elf = env.subst("$BUILD_DIR/${PROGNAME}.elf")
+    board = env.BoardConfig()
+    ram_total = int(board.get("upload.maximum_ram_size", 0))
+    flash_total = int(board.get("upload.maximum_size", 0))
+    threshold = int(env.GetProjectOption("custom_ram_headroom", "256"))
+
+    # Berkeley format: text data bss dec hex filename
+    text, data, bss = [int(v) for v in run([tool(env, "size"), "-B", elf]).splitlines()[1].split()[:3]]
+    static_ram = data + bss
+    flash = text + data
+
+    print("\nFlash %6d / %6d bytes" % (flash, flash_total))
+    print("RAM   %6d / %6d bytes static (.data %d, .bss %d)" % (static_ram, ram_total, data, bss))
+
+    map_path = os.path.join(build_dir, "firmware.map")
+    if os.path.exists(map_path):
+        print("\n%-36s %8s %8s" % ("module", "flash", "ram"))
+        for name, (f, r) in sorted(module_sizes(map_path).items(), key=lambda kv: -kv[1][0]):
+            print("%-36s %8d %8d" % (name, f, r))
+
+    frames, dynamic = stack_usage(build_dir)
+    graph, indirect, nonblocking = call_graph(tool(env, "objdump"), elf)
+    memo = {}
+    main_depth, main_path = worst_path("main", graph, frames, memo)
+    # Worst path of the blocking and of the non-blocking vectors, any vector can land on top of a non-blocking one
+    worst = {False: (0, []), True: (0, [])}
+    for f in graph:
+        if f.startswith("__vector_") or f.endswith("_Handler"):
+            depth, path = worst_path(f, graph, frames, memo)
+            if depth > worst[f in nonblocking][0]:
+                worst[f in nonblocking] = (depth, path)
+    isr_depth, isr_path = worst[False]
+    if worst[True][0]:
+        # The nested one is the worst of all vectors other than the non-blocking one itself
+        outer_depth, outer_path = worst[True]
+        inner_depth, inner_path = 0, []
+        for f in graph:
+            if (f.startswith("__vector_") or f.endswith("_Handler")) and f != outer_path[0]:
+                depth, path = worst_path(f, graph, frames, memo)
+                if depth > inner_depth:
+                    inner_depth, inner_path = depth, path
+        if outer_depth + inner_depth > isr_depth:
+            isr_depth, isr_path = outer_depth + inner_depth, outer_path + inner_path
+
+    print("\nWorst case stack: %d bytes (main %d + interrupt %d)" % (main_depth + isr_depth, main_depth, isr_depth))
+    if nonblocking:
+        print("  non-blocking ISRs, nested interrupts counted on top: " + ", ".join(sorted(nonblocking)))
+    for name in main_path:
+        print("  %6d  %s" % (frames.get(name, 0), name))
+    if isr_path:
+        print("  interrupt:")
+        for name in isr_path:
+            print("  %6d  %s" % (frames.get(name, 0), name))
+
+    on_path = set(main_path) | set(isr_path)
+    unknown = sorted(f for f in on_path if f not in frames and not f.endswith("(recursion)"))
+    if unknown:
+        print("  no stack info (counted as 0): " + ", ".join(unknown))
+    for name in sorted(dynamic & set(graph)):
+        print("  warning: %s has an unbounded dynamic stack frame (VLA or alloca)" % name)
+    for name in sorted(indirect & on_path):
+        if not any(p in name for p in INDIRECT_CALLS):
+            print("  warning: %s makes indirect calls not listed in INDIRECT_CALLS" % name)
+
+    headroom = ram_total - static_ram - main_depth - isr_depth
+    print("\nRAM headroom: %d bytes (threshold %d)" % (headroom, threshold))
+    if headroom < threshold:
+        print("Error: RAM headroom below custom_ram_headroom")
+        env.Exit(1)
+
+
+env.AddCustomTarget(  # noqa: F821
+    name="budget",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=[report],
+    title="Memory budget",
+    description="Static RAM, stack depth and flash per module, fails below custom_ram_headroom",
+)
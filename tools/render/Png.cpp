@@ -0,0 +1,97 @@
+#include "Png.h"
+#include <stdio.h>
+
+namespace Png
+{
+    static uint32_t crcTable[256];
+
+    static uint32_t crc(const uint8_t *data, size_t len, uint32_t c = 0xFFFFFFFFUL)
+    {
+        if (!crcTable[1])
+        {
+            for (uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t v = n;
+                for (uint8_t k = 0; k < 8; k++)
+                    v = (v & 1) ? 0xEDB88320UL ^ (v >> 1) : v >> 1;
+                crcTable[n] = v;
+            }
+        }
+        for (size_t i = 0; i < len; i++)
+            c = crcTable[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+        return c;
+    }
+
+    static void put32(std::vector<uint8_t> &out, uint32_t v)
+    {
+        out.push_back((uint8_t)(v >> 24));
+        out.push_back((uint8_t)(v >> 16));
+        out.push_back((uint8_t)(v >> 8));
+        out.push_back((uint8_t)v);
+    }
+
+    static void chunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &body)
+    {
+        put32(out, (uint32_t)body.size());
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), body.begin(), body.end());
+        put32(out, crc(&out[start], out.size() - start) ^ 0xFFFFFFFFUL);
+    }
+
+    bool write(const char *path, uint32_t width, uint32_t height, const std::vector<uint8_t> &rgb)
+    {
+        std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+        std::vector<uint8_t> header;
+        put32(header, width);
+        put32(header, height);
+        header.push_back(8); // Bit depth
+        header.push_back(2); // Truecolor
+        header.push_back(0); // Deflate
+        header.push_back(0); // Adaptive filtering
+        header.push_back(0); // No interlace
+        chunk(png, "IHDR", header);
+
+        // Raw scanlines, each prefixed with filter type 0
+        std::vector<uint8_t> raw;
+        raw.reserve((size_t)height * (width * 3 + 1));
+        for (uint32_t y = 0; y < height; y++)
+        {
+            raw.push_back(0);
+            raw.insert(raw.end(), rgb.begin() + (size_t)y * width * 3, rgb.begin() + (size_t)(y + 1) * width * 3);
+        }
+
+        // zlib stream of uncompressed deflate blocks
+        std::vector<uint8_t> z = {0x78, 0x01};
+        uint32_t a = 1, b = 0;
+        for (size_t pos = 0; pos < raw.size() || pos == 0;)
+        {
+            size_t len = raw.size() - pos > 65535 ? 65535 : raw.size() - pos;
+            z.push_back(pos + len == raw.size() ? 1 : 0);
+            z.push_back((uint8_t)len);
+            z.push_back((uint8_t)(len >> 8));
+            z.push_back((uint8_t)~len);
+            z.push_back((uint8_t)(~len >> 8));
+            for (size_t i = pos; i < pos + len; i++)
+            {
+                z.push_back(raw[i]);
+                a = (a + raw[i]) % 65521;
+                b = (b + a) % 65521;
+            }
+            pos += len;
+            if (len == 0)
+                break;
+        }
+        put32(z, b << 16 | a);
+        chunk(png, "IDAT", z);
+        chunk(png, "IEND", std::vector<uint8_t>());
+
+        FILE *f = fopen(path, "wb");
+        if (!f)
+            return false;
+        bool ok = fwrite(png.data(), 1, png.size(), f) == png.size();
+        return fclose(f) == 0 && ok;
+    }
+
+} // namespace Png
@@ -0,0 +1,10 @@
+#include <stdint.h>
+#include <vector>
+#define PNG_WRITER // Used to stop duplicate imports
+
+// Minimal PNG encoder (8 bit RGB, stored deflate blocks) so the tools need no zlib
+namespace Png
+{
+    // rgb holds width * height * 3 bytes, row major
+    bool write(const char *path, uint32_t width, uint32_t height, const std::vector<uint8_t> &rgb);
+}
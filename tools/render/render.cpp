@@ -0,0 +1,227 @@
+/**
+ * LocalMoodLamp/tools/render
+ *
+ * Offline renderer, samples animations through AnimationDriver::evaluate() and writes the
+ * per-millisecond RGB timeline as CSV or a PNG strip chart.
+ *
+ * Usage:
+ *  render [--default N | --default all | --slots dump.bin] [-d ms] [--csv out.csv] [--png out.png] [--bench N] [-j threads]
+ */
+
+#include <AnimationDriver.h>
+#include <DefaultAnimations.h>
+#include "../common/AnimationIO.h"
+#include "../common/Timeline.h"
+#include "Png.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Strip chart geometry, a swatch band followed by one plot per channel
+#define SWATCH_HEIGHT 16
+#define PLOT_HEIGHT 64
+#define ROW_HEIGHT (SWATCH_HEIGHT + 3 * PLOT_HEIGHT + 4)
+
+struct job
+{
+    std::string name;
+    AnimationDriver::animation anim;
+    std::vector<Timeline::rgb> timeline;
+};
+
+static void usage()
+{
+    fprintf(stderr, "usage: render [--default N|all] [--slots dump.bin] [-d ms] [--csv out.csv] [--png out.png] [--bench N] [-j threads]\n");
+    exit(2);
+}
+
+// Samples per unit of work, long timelines are split so a single animation still spreads over every thread
+#define CHUNK_MS 65536
+
+// Render every job over a pool of threads, chunks are claimed from a shared counter
+static void renderAll(std::vector<job> &jobs, uint32_t durationMs, unsigned threads)
+{
+    struct chunk
+    {
+        size_t job;
+        uint32_t start, count;
+    };
+    std::vector<chunk> chunks;
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        // Default to one animation period
+        uint32_t length = durationMs ? durationMs : jobs[j].anim.time;
+        jobs[j].timeline.resize(length);
+        for (uint32_t start = 0; start < length; start += CHUNK_MS)
+            chunks.push_back(chunk{j, start, length - start < CHUNK_MS ? length - start : CHUNK_MS});
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        pool.emplace_back([&]()
+                          {
+                              size_t i;
+                              while ((i = next++) < chunks.size())
+                              {
+                                  job &j = jobs[chunks[i].job];
+                                  Timeline::renderRange(j.anim, chunks[i].start, chunks[i].count, &j.timeline[chunks[i].start]);
+                              } });
+    }
+    for (size_t t = 0; t < pool.size(); t++)
+        pool[t].join();
+}
+
+static bool writeCsv(const char *path, const std::vector<job> &jobs)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+    fprintf(f, "anim,t,r,g,b\n");
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        const std::vector<Timeline::rgb> &tl = jobs[j].timeline;
+        for (size_t t = 0; t < tl.size(); t++)
+            fprintf(f, "%s,%zu,%u,%u,%u\n", jobs[j].name.c_str(), t, tl[t].r, tl[t].g, tl[t].b);
+    }
+    return fclose(f) == 0;
+}
+
+// One row per animation: color swatch on top, then R, G and B plotted over time
+static bool writePng(const char *path, const std::vector<job> &jobs)
+{
+    size_t width = 1;
+    for (size_t j = 0; j < jobs.size(); j++)
+        if (jobs[j].timeline.size() > width)
+            width = jobs[j].timeline.size();
+    size_t height = jobs.size() * ROW_HEIGHT;
+    std::vector<uint8_t> image(width * height * 3, 0);
+
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        const std::vector<Timeline::rgb> &tl = jobs[j].timeline;
+        size_t top = j * ROW_HEIGHT;
+        for (size_t x = 0; x < tl.size(); x++)
+        {
+            const uint8_t channels[3] = {tl[x].r, tl[x].g, tl[x].b};
+            for (size_t y = 0; y < SWATCH_HEIGHT; y++)
+            {
+                uint8_t *px = &image[((top + y) * width + x) * 3];
+                px[0] = channels[0];
+                px[1] = channels[1];
+                px[2] = channels[2];
+            }
+            for (uint8_t c = 0; c < 3; c++)
+            {
+                size_t plotBottom = top + SWATCH_HEIGHT + (c + 1) * PLOT_HEIGHT;
+                size_t y = plotBottom - 1 - channels[c] * (PLOT_HEIGHT - 1) / 255;
+                image[(y * width + x) * 3 + c] = 255;
+            }
+        }
+    }
+    return Png::write(path, (uint32_t)width, (uint32_t)height, image);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<job> jobs;
+    uint32_t durationMs = 0;
+    unsigned threads = std::thread::hardware_concurrency();
+    size_t bench = 0;
+    const char *csvPath = nullptr;
+    const char *pngPath = nullptr;
+    const size_t defaultCount = sizeof(defaults) / sizeof(AnimationDriver::animation);
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+            usage();
+        const char *value = argv[++i];
+        if (arg == "--default")
+        {
+            for (size_t d = 0; d < defaultCount; d++)
+            {
+                if (strcmp(value, "all") == 0 || (size_t)atoi(value) == d)
+                    jobs.push_back(job{"default" + std::to_string(d), defaults[d], {}});
+            }
+        }
+        else if (arg == "--slots")
+        {
+            std::vector<AnimationIO::slot> slots;
+            if (!AnimationIO::readDump(value, slots))
+            {
+                fprintf(stderr, "render: could not read slot dump %s\n", value);
+                return 1;
+            }
+            for (size_t s = 0; s < slots.size(); s++)
+                jobs.push_back(job{"slot" + std::to_string(slots[s].index), slots[s].anim, {}});
+        }
+        else if (arg == "-d")
+            durationMs = strtoul(value, nullptr, 0);
+        else if (arg == "--csv")
+            csvPath = value;
+        else if (arg == "--png")
+            pngPath = value;
+        else if (arg == "--bench")
+            bench = strtoul(value, nullptr, 0);
+        else if (arg == "-j")
+            threads = strtoul(value, nullptr, 0);
+        else
+            usage();
+    }
+    if (jobs.empty())
+        usage();
+    if (threads == 0)
+        threads = 1;
+
+    // Frame counts under 2 index past the frames the driver interpolates between
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        if (jobs[j].anim.frameCount < 2 || jobs[j].anim.frameCount > MAX_FRAMES)
+        {
+            fprintf(stderr, "render: %s has an unplayable frame count of %u\n", jobs[j].name.c_str(), jobs[j].anim.frameCount);
+            return 1;
+        }
+    }
+
+    if (bench)
+    {
+        // Replicate the inputs to get a batch large enough to time
+        std::vector<job> batch;
+        batch.reserve(bench);
+        for (size_t i = 0; i < bench; i++)
+            batch.push_back(jobs[i % jobs.size()]);
+        auto start = std::chrono::steady_clock::now();
+        renderAll(batch, durationMs, threads);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t samples = 0;
+        for (size_t i = 0; i < batch.size(); i++)
+            samples += batch[i].timeline.size();
+        printf("%zu animations, %zu samples in %.3f s on %u threads: %.0f anim/s, %.2f Msamples/s\n",
+               batch.size(), samples, seconds, threads, batch.size() / seconds, samples / seconds / 1e6);
+        return 0;
+    }
+
+    renderAll(jobs, durationMs, threads);
+    if (csvPath && !writeCsv(csvPath, jobs))
+    {
+        fprintf(stderr, "render: could not write %s\n", csvPath);
+        return 1;
+    }
+    if (pngPath && !writePng(pngPath, jobs))
+    {
+        fprintf(stderr, "render: could not write %s\n", pngPath);
+        return 1;
+    }
+    if (!csvPath && !pngPath)
+        writeCsv("/dev/stdout", jobs);
+    return 0;
+}
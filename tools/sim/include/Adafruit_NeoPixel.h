@@ -0,0 +1,61 @@
+// NeoPixel strip that records what would have been shown (see tools/sim/sim.cpp)
+// Mirrors the real library's protected layout so subclasses behave the same on host
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NEO_GRB 0x52
+#define NEO_KHZ800 0x0000
+typedef uint16_t neoPixelType;
+
+class Adafruit_NeoPixel
+{
+public:
+    Adafruit_NeoPixel(uint16_t n, int16_t p, neoPixelType type) : numLEDs(n), numBytes(n * 3), pin(p), brightness(0)
+    {
+        (void)type;
+        pixels = (uint8_t *)calloc(numBytes, 1);
+    }
+    ~Adafruit_NeoPixel() { free(pixels); }
+    void begin() {}
+    void show(); // Implemented by the simulator
+    void setBrightness(uint8_t b)
+    {
+        // Stored off by one like the real library so 0 means full scale
+        brightness = b + 1;
+    }
+    uint8_t getBrightness() const { return brightness - 1; }
+    void setPixelColor(uint16_t n, uint32_t c)
+    {
+        if (n >= numLEDs)
+            return;
+        uint8_t r = c >> 16, g = c >> 8, b = c;
+        if (brightness)
+        {
+            r = (r * brightness) >> 8;
+            g = (g * brightness) >> 8;
+            b = (b * brightness) >> 8;
+        }
+        uint8_t *p = &pixels[n * 3];
+        p[0] = g;
+        p[1] = r;
+        p[2] = b;
+    }
+    void fill(uint32_t c = 0, uint16_t first = 0, uint16_t count = 0)
+    {
+        uint16_t end = count == 0 || first + count > numLEDs ? numLEDs : first + count;
+        for (uint16_t i = first; i < end; i++)
+            setPixelColor(i, c);
+    }
+    uint8_t *getPixels() const { return pixels; }
+    uint16_t numPixels() const { return numLEDs; }
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) { return (uint32_t)r << 16 | (uint32_t)g << 8 | b; }
+
+protected:
+    uint16_t numLEDs;
+    uint16_t numBytes;
+    int16_t pin;
+    uint8_t brightness;
+    uint8_t *pixels;
+};
@@ -0,0 +1,88 @@
+// Minimal Arduino core for running main.cpp on a Linux host (see tools/sim/sim.cpp)
+#pragma once
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+typedef uint8_t byte;
+
+#define PROGMEM
+#define F(str) (str)
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define A0 14
+#define A3 17
+#define A7 21
+
+inline void *memcpy_P(void *dest, const void *src, size_t n) { return memcpy(dest, src, n); }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+// Receive buffer of the simulated UART, sized like the AVR core's so it holds one byte less than this.
+// Set past what the link can ever hold when nothing is dropped (no --drop), a full buffer only means drops with it
+extern size_t simRxBufferSize;
+#define SERIAL_RX_BUFFER_SIZE simRxBufferSize
+
+// Formatting base shared by Serial and other byte sinks, as in the real core
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t *buf, size_t len)
+    {
+        size_t n = 0;
+        while (len--)
+            n += write(*buf++);
+        return n;
+    }
+    size_t write(const char *buf, size_t len) { return write((const uint8_t *)buf, len); }
+    virtual void flush() {}
+
+    size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned long n) { return print(std::to_string(n).c_str()); }
+    size_t print(long n) { return print(std::to_string(n).c_str()); }
+    size_t print(unsigned int n) { return print((unsigned long)n); }
+    size_t print(int n) { return print((long)n); }
+    size_t print(unsigned char n) { return print((unsigned long)n); }
+    template <typename T>
+    size_t println(const T &v) { return print(v) + println(); }
+    size_t println() { return print("\r\n"); }
+};
+
+// Serial port backed by the simulator's pseudo-terminal
+class SimSerial : public Print
+{
+public:
+    void begin(unsigned long) {}
+    int available();
+    int availableForWrite();
+    int read();
+    int peek();
+    size_t write(uint8_t) override;
+    size_t write(const uint8_t *, size_t) override;
+    using Print::write;
+    size_t readBytes(uint8_t *, size_t);
+    size_t readBytes(char *buf, size_t len) { return readBytes((uint8_t *)buf, len); }
+    void setTimeout(unsigned long ms) { timeout = ms; }
+    void flush() override;
+    operator bool() { return true; }
+
+private:
+    int timedRead();
+    unsigned long timeout = 1000;
+};
+
+extern SimSerial Serial;
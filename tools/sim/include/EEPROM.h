@@ -0,0 +1,34 @@
+// AVR style EEPROM backed by simulator RAM (see tools/sim/sim.cpp)
+#pragma once
+#include <stdint.h>
+
+#define SIM_EEPROM_SIZE 1024
+
+class EEPROMClass
+{
+public:
+    uint8_t read(int idx);
+    void write(int idx, uint8_t val);
+    void update(int idx, uint8_t val);
+    uint16_t length() { return SIM_EEPROM_SIZE; }
+
+    template <typename T>
+    T &get(int idx, T &t)
+    {
+        uint8_t *ptr = (uint8_t *)&t;
+        for (unsigned i = 0; i < sizeof(T); i++)
+            ptr[i] = read(idx + i);
+        return t;
+    }
+
+    template <typename T>
+    const T &put(int idx, const T &t)
+    {
+        const uint8_t *ptr = (const uint8_t *)&t;
+        for (unsigned i = 0; i < sizeof(T); i++)
+            update(idx + i, ptr[i]);
+        return t;
+    }
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,157 @@
+"""
+Round trip check of lampctl against the simulator.
+
+Usage:
+    python tools/sim/roundtrip.py [--sim .pio/build/sim/program] [--lampctl .pio/build/lampctl/program] [--pipeline]
+
+Starts the simulator on a fresh EEPROM file, then runs download, upload, preview, commit, stream, backup and restore
+through lampctl and compares what the lamp reports back against what was sent. Exits non zero on the first mismatch.
+"""
+import argparse
+import os
+import signal
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+FRAME = struct.Struct(">3BI")  # R, G, B, big endian time, as in a slot dump
+
+
+def parse_dump(data):
+    """Slot dump -> {slot: (frame count, frames bytes)}"""
+    slots = {}
+    i = 0
+    while i + 2 <= len(data):
+        index, count = data[i], data[i + 1]
+        slots[index] = data[i : i + 2 + count * FRAME.size]
+        i += 2 + count * FRAME.size
+    return slots
+
+
+def record(index, frames):
+    """One slot dump record from (r, g, b, t) tuples"""
+    return bytes([index, len(frames)]) + b"".join(FRAME.pack(*f) for f in frames)
+
+
+class Check:
+    def __init__(self, lampctl, port, work, pipeline):
+        self.lampctl = lampctl
+        self.port = port
+        self.work = work
+        self.pipeline = ["--pipeline"] if pipeline else []
+
+    def run(self, *args):
+        cmd = [self.lampctl, self.port] + list(args)
+        result = subprocess.run(cmd, capture_output=True, text=True, timeout=60)
+        if result.returncode != 0:
+            sys.exit("roundtrip: %s failed\n%s%s" % (" ".join(args), result.stdout, result.stderr))
+
+    def path(self, name):
+        return os.path.join(self.work, name)
+
+    def write(self, name, data):
+        with open(self.path(name), "wb") as f:
+            f.write(data)
+        return self.path(name)
+
+    def read(self, name):
+        with open(self.path(name), "rb") as f:
+            return f.read()
+
+    def download(self, name):
+        self.run("download", self.path(name), *self.pipeline)
+        return parse_dump(self.read(name))
+
+    def backup(self, name):
+        self.run("backup", self.path(name))
+        return self.read(name)
+
+
+def wait_for_boot(port, deadline):
+    # The simulator keeps the PTY raw, setting it again here would flush the line
+    fd = os.open(port, os.O_RDWR | os.O_NOCTTY | os.O_NONBLOCK)
+    try:
+        seen = b""
+        while b"ready\r\n" not in seen:
+            if time.time() > deadline:
+                sys.exit("roundtrip: no boot line from the simulator")
+            try:
+                seen += os.read(fd, 64)
+            except BlockingIOError:
+                time.sleep(0.01)
+    finally:
+        os.close(fd)
+
+
+def expect(what, got, wanted):
+    if got != wanted:
+        sys.exit("roundtrip: %s mismatch\n  got    %s\n  wanted %s" % (what, got.hex() if isinstance(got, bytes) else got,
+                                                                           wanted.hex() if isinstance(wanted, bytes) else wanted))
+    print("ok  %s" % what)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--sim", default=".pio/build/sim/program")
+    parser.add_argument("--lampctl", default=".pio/build/lampctl/program")
+    parser.add_argument("--pipeline", action="store_true", help="run downloads and uploads with --pipeline")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as work:
+        port = os.path.join(work, "lamp")
+        sim = subprocess.Popen([args.sim, "--link", port, "--eeprom", os.path.join(work, "eeprom.bin"), "--baud", "0"],
+                               stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+        try:
+            deadline = time.time() + 5
+            while not os.path.exists(port):
+                if time.time() > deadline or sim.poll() is not None:
+                    sys.exit("roundtrip: simulator did not come up")
+                time.sleep(0.05)
+            # The link shows up before setup() runs, swallow the boot line so it isn't taken for a reply
+            wait_for_boot(port, deadline)
+            lamp = Check(args.lampctl, port, work, args.pipeline)
+
+            original = lamp.download("original.bin")
+            image = lamp.backup("original.img")
+            expect("download repeats", lamp.download("again.bin"), original)
+
+            # Upload replaces one slot and leaves the rest alone
+            uploaded = record(2, [(255, 0, 0, 0), (0, 255, 0, 700), (0, 0, 255, 1400)])
+            lamp.run("upload", lamp.write("upload.bin", uploaded), *lamp.pipeline)
+            wanted = dict(original)
+            wanted[2] = uploaded
+            expect("upload", lamp.download("uploaded.bin"), wanted)
+
+            # A preview plays from RAM only, commit then stores it in the slot it was previewed for
+            previewed = record(4, [(10, 20, 30, 0), (40, 50, 60, 250)])
+            lamp.run("preview", lamp.write("preview.bin", previewed))
+            expect("preview leaves storage alone", lamp.download("previewed.bin"), wanted)
+            lamp.run("commit")
+            wanted[4] = previewed
+            expect("commit", lamp.download("committed.bin"), wanted)
+
+            # A stream is a run of previews, the last one is what ends up playing and what a commit stores
+            streamed = [record(1, [(i * 40, 0, 255 - i * 40, 0), (0, i * 40, 0, 100)]) for i in range(6)]
+            lamp.run("stream", lamp.write("stream.bin", b"".join(streamed)), "50")
+            expect("stream leaves storage alone", lamp.download("streamed.bin"), wanted)
+            lamp.run("commit")
+            wanted[1] = streamed[-1]
+            expect("stream commit", lamp.download("stream_committed.bin"), wanted)
+
+            # Restoring the backup undoes both
+            lamp.run("restore", lamp.path("original.img"))
+            expect("restore image", lamp.backup("restored.img"), image)
+            expect("restore slots", lamp.download("restored.bin"), original)
+        finally:
+            sim.send_signal(signal.SIGINT)
+            try:
+                sim.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                sim.kill()
+    print("roundtrip: all checks passed")
+
+
+if __name__ == "__main__":
+    main()
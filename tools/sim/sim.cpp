@@ -0,0 +1,598 @@
+/**
+ * LocalMoodLamp/tools/sim
+ *
+ * Runs the real main.cpp on a Linux host with its Serial port exposed as a pseudo-terminal,
+ * so any host client (lampctl, Lamp Station, a terminal) can talk to a virtual lamp.
+ *
+ * Usage:
+ *  sim [--link path] [--baud N] [--latency-us N] [--rx-buffer N] [--drop] [--eeprom file] [--eeprom-write-us N] [--pot N] [--adc-us N]
+ *      [--press PIN@MS]... [-v]
+ *
+ *  --link          Symlink to create for the PTY (the PTY path is printed either way)
+ *  --baud          Wire speed model, 10 bits per byte each way. 0 disables throttling (USB CDC) (default 115200)
+ *  --latency-us    Extra one-way delay added to every byte (default 0)
+ *  --rx-buffer     Receive buffer size of the modelled core (default 64)
+ *  --drop          Drop bytes when the receive buffer is full (UART) instead of holding them back (USB CDC)
+ *  --eeprom        File to persist EEPROM in, seeded with defaults[] if missing
+ *  --eeprom-write-us  Time a changed EEPROM byte takes to write (default 3300, AVR)
+ *  --pot           Value analogRead returns for the brightness dial (default 1023)
+ *  --adc-us        Time analogRead takes (default 0, about 110 on the AVRs)
+ *  --press         Hold a button pin low for 300 ms starting MS after boot, repeatable (NANO pinout: 3 up, 4 down)
+ *  -v              Print every color change that gets shown
+ *
+ * USB packets are counted like a CDC core that sends every Serial.write() call as its own transfer:
+ * one packet per started 64 bytes of each call.
+ *
+ * The exit summary also reports the interval between strip refreshes and its standard deviation, the render step
+ * itself is timed by the "frame" section of a -D PROFILE build. Built with -D RENDER_TIMER the render tick runs on its own thread at RENDER_RATE, masked by
+ * RenderTimer::hold() the way the hardware timer interrupt is.
+ */
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Adafruit_NeoPixel.h>
+#include <AnimationDriver.h>
+#include <DefaultAnimations.h>
+#include <RenderTimer.h>
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Firmware entry points and the reset hook main.cpp uses under SIM
+void setup();
+void loop();
+
+struct SimReset
+{
+};
+
+void resetFunc()
+{
+    throw SimReset();
+}
+
+// Simulation options
+static unsigned long baud = 115200;
+static unsigned long latencyUs = 0;
+static size_t rxCapacity = 64;
+size_t simRxBufferSize = INT_MAX;
+static size_t txCapacity = 64;
+static const size_t USB_PACKET = 64; // Full speed bulk endpoint size
+static bool dropOnOverflow = false;
+static const char *eepromPath = nullptr;
+static unsigned long eepromWriteUs = 3300;
+static int potValue = 1023;
+static unsigned long adcUs = 0;
+
+// Scripted button presses
+struct press
+{
+    uint8_t pin;
+    unsigned long at;
+};
+static std::vector<press> presses;
+#define PRESS_MS 300
+static bool verbose = false;
+
+typedef std::chrono::steady_clock simClock;
+static const simClock::time_point bootTime = simClock::now();
+static volatile sig_atomic_t stopRequested = 0;
+
+static int ptyFd = -1;
+
+// Bytes in flight, each with the time it becomes visible at the other end
+struct timedByte
+{
+    simClock::time_point due;
+    uint8_t value;
+};
+
+static std::mutex rxLock, txLock;
+static std::condition_variable rxSpace, txReady, txDrained;
+static std::deque<timedByte> rxQueue, txQueue;
+static simClock::time_point rxWireFree = bootTime, txWireFree = bootTime;
+
+// Counters reported on exit
+static unsigned long rxBytes = 0, rxDropped = 0, rxHighWater = 0, txBytes = 0, usbPackets = 0, shows = 0, eepromWrites = 0;
+
+// Refresh interval stats (us), over every strip refresh after the first
+static unsigned long intervalMin = ULONG_MAX, intervalMax = 0;
+static double intervalSum = 0, intervalSumSq = 0;
+
+static simClock::duration byteTime()
+{
+    return baud ? std::chrono::microseconds(10000000UL / baud) : simClock::duration::zero();
+}
+
+// Schedule a byte on a wire that can only carry one byte per byteTime
+static simClock::time_point schedule(simClock::time_point &wireFree)
+{
+    simClock::time_point start = simClock::now();
+    if (wireFree > start)
+        start = wireFree;
+    wireFree = start + byteTime();
+    return wireFree + std::chrono::microseconds(latencyUs);
+}
+
+// Host -> lamp
+static void rxThread()
+{
+    uint8_t chunk[64];
+    while (!stopRequested)
+    {
+        {
+            // With flow control leave bytes in the PTY until the core has room for them
+            std::unique_lock<std::mutex> lock(rxLock);
+            if (!dropOnOverflow)
+                rxSpace.wait_for(lock, std::chrono::milliseconds(50), []
+                                 { return rxQueue.size() < rxCapacity; });
+            if (!dropOnOverflow && rxQueue.size() >= rxCapacity)
+                continue;
+        }
+        pollfd p = {ptyFd, POLLIN, 0};
+        if (poll(&p, 1, 50) <= 0)
+            continue;
+        size_t room = sizeof(chunk);
+        if (!dropOnOverflow)
+        {
+            std::lock_guard<std::mutex> lock(rxLock);
+            room = rxCapacity - rxQueue.size();
+            if (room > sizeof(chunk))
+                room = sizeof(chunk);
+        }
+        ssize_t n = ::read(ptyFd, chunk, room);
+        if (n <= 0)
+        {
+            usleep(1000);
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(rxLock);
+        for (ssize_t i = 0; i < n; i++)
+        {
+            simClock::time_point due = schedule(rxWireFree);
+            rxBytes++;
+            if (rxQueue.size() >= rxCapacity)
+            {
+                rxDropped++;
+                continue;
+            }
+            rxQueue.push_back(timedByte{due, chunk[i]});
+            if (rxQueue.size() > rxHighWater)
+                rxHighWater = rxQueue.size();
+        }
+    }
+}
+
+// Lamp -> host
+static void txThread()
+{
+    std::unique_lock<std::mutex> lock(txLock);
+    while (!stopRequested)
+    {
+        if (txQueue.empty())
+        {
+            txDrained.notify_all();
+            txReady.wait_for(lock, std::chrono::milliseconds(50));
+            continue;
+        }
+        simClock::time_point due = txQueue.front().due;
+        if (due > simClock::now())
+        {
+            txReady.wait_until(lock, due);
+            continue;
+        }
+        // Send everything that is due in one write
+        uint8_t chunk[256];
+        size_t n = 0;
+        simClock::time_point now = simClock::now();
+        while (n < sizeof(chunk) && !txQueue.empty() && txQueue.front().due <= now)
+        {
+            chunk[n++] = txQueue.front().value;
+            txQueue.pop_front();
+        }
+        txDrained.notify_all();
+        lock.unlock();
+        size_t sent = 0;
+        while (sent < n)
+        {
+            ssize_t w = ::write(ptyFd, chunk + sent, n - sent);
+            if (w > 0)
+                sent += w;
+            else
+                usleep(1000);
+        }
+        lock.lock();
+        txBytes += n;
+    }
+}
+
+// Arduino core
+
+SimSerial Serial;
+EEPROMClass EEPROM;
+
+static uint8_t eepromData[SIM_EEPROM_SIZE];
+static bool eepromDirty = false;
+
+unsigned long millis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(simClock::now() - bootTime).count();
+}
+
+unsigned long micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(simClock::now() - bootTime).count();
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+int digitalRead(uint8_t pin)
+{
+    // Buttons are pulled up, low only during a scripted press
+    unsigned long now = millis();
+    for (size_t i = 0; i < presses.size(); i++)
+    {
+        if (presses[i].pin == pin && now >= presses[i].at && now < presses[i].at + PRESS_MS)
+            return LOW;
+    }
+    return HIGH;
+}
+
+int analogRead(uint8_t)
+{
+    if (adcUs)
+        std::this_thread::sleep_for(std::chrono::microseconds(adcUs));
+    return potValue;
+}
+
+int SimSerial::available()
+{
+    std::lock_guard<std::mutex> lock(rxLock);
+    simClock::time_point now = simClock::now();
+    int count = 0;
+    for (size_t i = 0; i < rxQueue.size() && rxQueue[i].due <= now; i++)
+        count++;
+    return count;
+}
+
+int SimSerial::availableForWrite()
+{
+    std::lock_guard<std::mutex> lock(txLock);
+    return txQueue.size() >= txCapacity ? 0 : txCapacity - txQueue.size();
+}
+
+int SimSerial::peek()
+{
+    std::lock_guard<std::mutex> lock(rxLock);
+    if (rxQueue.empty() || rxQueue.front().due > simClock::now())
+        return -1;
+    return rxQueue.front().value;
+}
+
+int SimSerial::read()
+{
+    std::lock_guard<std::mutex> lock(rxLock);
+    if (rxQueue.empty() || rxQueue.front().due > simClock::now())
+        return -1;
+    uint8_t value = rxQueue.front().value;
+    rxQueue.pop_front();
+    rxSpace.notify_one();
+    return value;
+}
+
+int SimSerial::timedRead()
+{
+    unsigned long start = millis();
+    do
+    {
+        int c = read();
+        if (c >= 0)
+            return c;
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+    } while (millis() - start < timeout);
+    return -1;
+}
+
+size_t SimSerial::readBytes(uint8_t *buf, size_t len)
+{
+    size_t count = 0;
+    while (count < len)
+    {
+        int c = timedRead();
+        if (c < 0)
+            break;
+        buf[count++] = c;
+    }
+    return count;
+}
+
+static void queueTx(uint8_t value)
+{
+    std::unique_lock<std::mutex> lock(txLock);
+    // Block like the real core does when its transmit buffer is full
+    txDrained.wait(lock, []
+                   { return txQueue.size() < txCapacity; });
+    txQueue.push_back(timedByte{schedule(txWireFree), value});
+    txReady.notify_one();
+}
+
+size_t SimSerial::write(uint8_t value)
+{
+    usbPackets++;
+    queueTx(value);
+    return 1;
+}
+
+size_t SimSerial::write(const uint8_t *buf, size_t len)
+{
+    usbPackets += (len + USB_PACKET - 1) / USB_PACKET;
+    for (size_t i = 0; i < len; i++)
+        queueTx(buf[i]);
+    return len;
+}
+
+void SimSerial::flush()
+{
+    std::unique_lock<std::mutex> lock(txLock);
+    txDrained.wait(lock, []
+                   { return txQueue.empty(); });
+}
+
+uint8_t EEPROMClass::read(int idx)
+{
+    return idx >= 0 && idx < SIM_EEPROM_SIZE ? eepromData[idx] : 0xFF;
+}
+
+void EEPROMClass::write(int idx, uint8_t val)
+{
+    if (idx < 0 || idx >= SIM_EEPROM_SIZE)
+        return;
+    eepromData[idx] = val;
+    eepromDirty = true;
+    eepromWrites++;
+    std::this_thread::sleep_for(std::chrono::microseconds(eepromWriteUs));
+}
+
+void EEPROMClass::update(int idx, uint8_t val)
+{
+    if (read(idx) != val)
+        write(idx, val);
+}
+
+void Adafruit_NeoPixel::show()
+{
+    static uint32_t lastShown = UINT32_MAX;
+    static unsigned long lastShowUs = 0;
+    unsigned long now = micros();
+    if (shows)
+    {
+        unsigned long interval = now - lastShowUs;
+        intervalMin = interval < intervalMin ? interval : intervalMin;
+        intervalMax = interval > intervalMax ? interval : intervalMax;
+        intervalSum += interval;
+        intervalSumSq += (double)interval * interval;
+    }
+    lastShowUs = now;
+    shows++;
+    if (verbose && numBytes >= 3)
+    {
+        uint32_t color = (uint32_t)pixels[1] << 16 | (uint32_t)pixels[0] << 8 | pixels[2];
+        if (color != lastShown)
+            fprintf(stderr, "[%8lu ms] show %02x%02x%02x\n", millis(), pixels[1], pixels[0], pixels[2]);
+        lastShown = color;
+    }
+    // 30 us per pixel on the wire plus the latch, numBytes may be cut short for a partial refresh
+    std::this_thread::sleep_for(std::chrono::microseconds(numBytes / 3 * 30 + 50));
+}
+
+#ifdef RENDER_TIMER
+// Render tick thread standing in for the timer interrupt, hold() takes the same lock the tick runs under
+namespace RenderTimer
+{
+    static std::recursive_mutex tickLock;
+    static std::thread tickThread;
+    static std::atomic<tickFunc> callback(nullptr);
+    static std::atomic<long> periodUs(0);
+
+    static void run()
+    {
+        simClock::time_point next = simClock::now();
+        while (!stopRequested)
+        {
+            next += std::chrono::microseconds(periodUs.load());
+            std::this_thread::sleep_until(next);
+            std::lock_guard<std::recursive_mutex> lock(tickLock);
+            callback.load()();
+        }
+    }
+
+    void begin(uint16_t hz, tickFunc tick)
+    {
+        callback = tick;
+        periodUs = 1000000L / hz;
+        // setup() runs again after a reset, keep the one thread
+        if (!tickThread.joinable())
+            tickThread = std::thread(run);
+    }
+
+    void hold()
+    {
+        tickLock.lock();
+    }
+
+    void release()
+    {
+        tickLock.unlock();
+    }
+
+} // namespace RenderTimer
+#endif
+
+// Simulator
+
+static void loadEeprom()
+{
+    memset(eepromData, 0xFF, sizeof(eepromData));
+    FILE *f = eepromPath ? fopen(eepromPath, "rb") : nullptr;
+    if (f)
+    {
+        fread(eepromData, 1, sizeof(eepromData), f);
+        fclose(f);
+        return;
+    }
+    // Fresh part, seed it the way WRITE_EEPROM would
+    for (size_t i = 0; i < sizeof(defaults) / sizeof(AnimationDriver::animation); i++)
+        memcpy(&eepromData[i * sizeof(AnimationDriver::animation)], &defaults[i], sizeof(AnimationDriver::animation));
+    eepromDirty = true;
+}
+
+static void saveEeprom()
+{
+    if (!eepromDirty || !eepromPath)
+        return;
+    FILE *f = fopen(eepromPath, "wb");
+    if (f)
+    {
+        fwrite(eepromData, 1, sizeof(eepromData), f);
+        fclose(f);
+    }
+    eepromDirty = false;
+}
+
+static void onSignal(int)
+{
+    stopRequested = 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *linkPath = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : "0";
+        if (arg == "-v")
+        {
+            verbose = true;
+            continue;
+        }
+        if (arg == "--drop")
+        {
+            dropOnOverflow = true;
+            continue;
+        }
+        i++;
+        if (arg == "--link")
+            linkPath = value;
+        else if (arg == "--baud")
+            baud = strtoul(value, nullptr, 0);
+        else if (arg == "--latency-us")
+            latencyUs = strtoul(value, nullptr, 0);
+        else if (arg == "--rx-buffer")
+            rxCapacity = strtoul(value, nullptr, 0);
+        else if (arg == "--eeprom")
+            eepromPath = value;
+        else if (arg == "--eeprom-write-us")
+            eepromWriteUs = strtoul(value, nullptr, 0);
+        else if (arg == "--pot")
+            potValue = atoi(value);
+        else if (arg == "--adc-us")
+            adcUs = strtoul(value, nullptr, 0);
+        else if (arg == "--press" && strchr(value, '@'))
+            presses.push_back(press{(uint8_t)atoi(value), strtoul(strchr(value, '@') + 1, nullptr, 0)});
+        else
+        {
+            fprintf(stderr, "sim: unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    if (rxCapacity == 0)
+        rxCapacity = 1;
+    if (dropOnOverflow)
+        simRxBufferSize = rxCapacity + 1;
+
+    ptyFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (ptyFd < 0 || grantpt(ptyFd) || unlockpt(ptyFd))
+    {
+        perror("sim: pty");
+        return 1;
+    }
+    const char *ptyName = ptsname(ptyFd);
+    // Hold the slave open in raw mode so the master never sees EIO between clients
+    int slaveFd = open(ptyName, O_RDWR | O_NOCTTY);
+    termios tio;
+    if (slaveFd >= 0 && tcgetattr(slaveFd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(slaveFd, TCSANOW, &tio);
+    }
+    if (linkPath)
+    {
+        unlink(linkPath);
+        if (symlink(ptyName, linkPath))
+            perror("sim: link");
+    }
+    printf("sim: virtual lamp on %s\n", linkPath ? linkPath : ptyName);
+    fflush(stdout);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    loadEeprom();
+    std::thread rx(rxThread), tx(txThread);
+
+    while (!stopRequested)
+    {
+        try
+        {
+            setup();
+            while (!stopRequested)
+            {
+                loop();
+                saveEeprom();
+            }
+        }
+        catch (SimReset &)
+        {
+            fprintf(stderr, "[%8lu ms] reset\n", millis());
+            saveEeprom();
+        }
+    }
+
+    rx.join();
+    tx.join();
+#ifdef RENDER_TIMER
+    if (RenderTimer::tickThread.joinable())
+        RenderTimer::tickThread.join();
+#endif
+    saveEeprom();
+    if (linkPath)
+        unlink(linkPath);
+    fprintf(stderr, "sim: rx %lu bytes (%lu dropped, high water %lu), tx %lu bytes in %lu USB packets, %lu shows, %lu EEPROM byte writes\n",
+            rxBytes, rxDropped, rxHighWater, txBytes, usbPackets, shows, eepromWrites);
+    if (shows > 1)
+    {
+        double mean = intervalSum / (shows - 1);
+        double jitter = sqrt(intervalSumSq / (shows - 1) - mean * mean);
+        fprintf(stderr, "sim: refresh interval %.0f us (min %lu, max %lu, std dev %.0f)\n", mean, intervalMin, intervalMax, jitter);
+    }
+    close(slaveFd);
+    return 0;
+}
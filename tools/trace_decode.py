@@ -0,0 +1,87 @@
+"""
+Decodes the binary trace stream from a -D TRACE build into a timeline.
+
+Usage:
+    python trace_decode.py capture.bin [-o trace.json] [--csv]
+
+The default output is Chrome trace event JSON (open in ui.perfetto.dev or chrome://tracing).
+The capture is the raw serial output of the lamp, e.g. `pio device monitor --raw > capture.bin`.
+"""
+import argparse
+import json
+import struct
+import sys
+
+SYNC = 0xA5
+RECORD = struct.Struct("<B3BI")  # Matches Tracer::record
+
+# Names match Tracer::eventType
+EVENTS = ["FRAME_ADVANCE", "COLOR", "MODE_CHANGE", "EEPROM_LOAD", "EEPROM_SAVE", "DROPPED"]
+
+
+def parse(data):
+    """Yields (type, data bytes, time in us) with the micros() wraparound unrolled"""
+    i = 0
+    last = None
+    offset = 0
+    while i + 1 + RECORD.size <= len(data):
+        # Resync on anything that isn't a record start
+        if data[i] != SYNC or data[i + 1] >= len(EVENTS):
+            i += 1
+            continue
+        kind, a, b, c, t = RECORD.unpack_from(data, i + 1)
+        i += 1 + RECORD.size
+        if last is not None and t < last:
+            offset += 1 << 32
+        last = t
+        yield kind, (a, b, c), t + offset
+
+
+def to_chrome(records):
+    events = []
+    for kind, (a, b, c), t in records:
+        name = EVENTS[kind]
+        if kind == 1:  # COLOR, drawn as a counter track
+            events.append({"name": "color", "ph": "C", "ts": t, "pid": 0, "args": {"r": a, "g": b, "b": c}})
+        elif kind == 0:
+            events.append({"name": name, "ph": "i", "s": "t", "ts": t, "pid": 0, "tid": 0,
+                           "args": {"frame": a, "frameCount": b, "wrapped": c}})
+        elif kind == 2:
+            events.append({"name": name, "ph": "i", "s": "g", "ts": t, "pid": 0, "tid": 1,
+                           "args": {"mode": a, "last": b}})
+        elif kind in (3, 4):
+            events.append({"name": name, "ph": "i", "s": "t", "ts": t, "pid": 0, "tid": 2,
+                           "args": {"slot": a, "frameCount": b}})
+        else:
+            events.append({"name": name, "ph": "i", "s": "g", "ts": t, "pid": 0, "tid": 3,
+                           "args": {"count": a | b << 8 | c << 16}})
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def to_csv(records, out):
+    out.write("time_us,event,a,b,c\n")
+    for kind, (a, b, c), t in records:
+        out.write("%d,%s,%d,%d,%d\n" % (t, EVENTS[kind], a, b, c))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture")
+    parser.add_argument("-o", "--output", help="output file (default stdout)")
+    parser.add_argument("--csv", action="store_true", help="write CSV instead of Chrome trace JSON")
+    args = parser.parse_args()
+
+    with open(args.capture, "rb") as f:
+        records = list(parse(f.read()))
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    if args.csv:
+        to_csv(records, out)
+    else:
+        json.dump(to_chrome(records), out)
+    if args.output:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()